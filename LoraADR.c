@@ -0,0 +1,613 @@
+/*********************************************************************
+*
+*   NAME:
+*       loraADR.c
+*
+*   DESCRIPTION:
+*       Adaptive data rate for the LoRa API. Tracks SNR margin and
+*       packet loss per peer and steps spreading factor, bandwidth
+*       and tx power one notch at a time with hysteresis.
+*
+*       Decision logic only touches the tables in this file, the
+*       radio is only written in lora_adr_apply(), so link
+*       conditions can be scripted through the report functions.
+*       Settings chosen for a peer must be signaled to that peer
+*       by the application before applying them.
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+#include "LoraADR.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define QDB_PER_DB              ( 4 )      /* SNR register resolution   */
+
+#define SF_STEP_COST_QDB        ( 10 )     /* 2.5 dB sensitivity per SF */
+
+#define BW_STEP_COST_QDB        ( 12 )     /* 3 dB noise per BW double  */
+
+#define PERCENT                 ( 100 )    /* percent scaler            */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef struct
+    {
+    bool               in_use;            /* entry allocated        */
+    uint8_t            peer;              /* peer address           */
+    lora_link_settings settings;          /* current link settings  */
+    int32_t            snr_sum;           /* SNR sum in window      */
+    uint16_t           snr_count;         /* SNR samples in window  */
+    uint16_t           tx_count;          /* tx samples in window   */
+    uint16_t           lost_count;        /* lost tx in window      */
+    } adr_peer_state;                     /* per peer ADR state     */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+static const int8_t s_snr_floor_qdb[] =   /* demodulation floor in
+                                             0.25 dB indexed by
+                                             SF - LORA_SF_7          */
+    {
+    -30,                                  /* SF7  -7.5 dB           */
+    -40,                                  /* SF8  -10  dB           */
+    -50,                                  /* SF9  -12.5dB           */
+    -60,                                  /* SF10 -15  dB           */
+    -70,                                  /* SF11 -17.5dB           */
+    -80                                   /* SF12 -20  dB           */
+    };
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+static adr_peer_state  s_peers[LORA_ADR_MAX_PEERS]; /* peer table   */
+static lora_adr_config s_config;                    /* ADR limits   */
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+static adr_peer_state * adr_find_peer
+    (
+    uint8_t peer                          /* peer address           */
+    );
+
+static void adr_reset_window
+    (
+    adr_peer_state *state                 /* peer to reset          */
+    );
+
+static bool adr_step_up
+    (
+    lora_link_settings *settings          /* settings to adjust     */
+    );
+
+static bool adr_step_down
+    (
+    lora_link_settings *settings,         /* settings to adjust     */
+    int32_t             margin            /* margin in 0.25 dB      */
+    );
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       adr_find_peer
+*
+*   DESCRIPTION:
+*       returns table entry for peer or NULL
+*
+*********************************************************************/
+static adr_peer_state * adr_find_peer
+    (
+    uint8_t peer                          /* peer address           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Search peer table
+----------------------------------------------------------*/
+for( i = 0; i < LORA_ADR_MAX_PEERS; i++ )
+    {
+    if( s_peers[i].in_use && s_peers[i].peer == peer )
+        {
+        return &s_peers[i];
+        }
+    }
+
+return NULL;
+
+} /* adr_find_peer() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       adr_reset_window
+*
+*   DESCRIPTION:
+*       clears measurement window for a peer
+*
+*********************************************************************/
+static void adr_reset_window
+    (
+    adr_peer_state *state                 /* peer to reset          */
+    )
+{
+state->snr_sum    = 0;
+state->snr_count  = 0;
+state->tx_count   = 0;
+state->lost_count = 0;
+
+} /* adr_reset_window() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       adr_step_up
+*
+*   DESCRIPTION:
+*       makes link one step more robust. Power is raised first
+*       as it costs no airtime, then SF is raised, then
+*       bandwidth narrowed.
+*
+*********************************************************************/
+static bool adr_step_up
+    (
+    lora_link_settings *settings          /* settings to adjust     */
+    )
+{
+if( settings->power_dbm < s_config.max_power_dbm )
+    {
+    settings->power_dbm += s_config.power_step_db;
+    if( settings->power_dbm > s_config.max_power_dbm )
+        {
+        settings->power_dbm = s_config.max_power_dbm;
+        }
+    return true;
+    }
+
+if( settings->spreading_factor < s_config.max_sf )
+    {
+    settings->spreading_factor++;
+    return true;
+    }
+
+if( settings->bandwidth > s_config.min_bw )
+    {
+    settings->bandwidth--;
+    return true;
+    }
+
+return false;
+
+} /* adr_step_up() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       adr_step_down
+*
+*   DESCRIPTION:
+*       spends surplus margin one step at a time. Data rate is
+*       raised first (lower SF, then wider bandwidth), then tx
+*       power is lowered. A step is only taken if the margin
+*       left afterwards is at least the hysteresis.
+*
+*********************************************************************/
+static bool adr_step_down
+    (
+    lora_link_settings *settings,         /* settings to adjust     */
+    int32_t             margin            /* margin in 0.25 dB      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int32_t hysteresis;             /* hysteresis in 0.25 dB  */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+hysteresis = s_config.hysteresis_db * QDB_PER_DB;
+
+if( settings->spreading_factor > s_config.min_sf &&
+    margin >= SF_STEP_COST_QDB + hysteresis )
+    {
+    settings->spreading_factor--;
+    return true;
+    }
+
+if( settings->bandwidth < s_config.max_bw &&
+    margin >= BW_STEP_COST_QDB + hysteresis )
+    {
+    settings->bandwidth++;
+    return true;
+    }
+
+if( settings->power_dbm > s_config.min_power_dbm &&
+    margin >= ( s_config.power_step_db * QDB_PER_DB ) + hysteresis )
+    {
+    settings->power_dbm -= s_config.power_step_db;
+    if( settings->power_dbm < s_config.min_power_dbm )
+        {
+        settings->power_dbm = s_config.min_power_dbm;
+        }
+    return true;
+    }
+
+return false;
+
+} /* adr_step_down() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_default_config
+*
+*   DESCRIPTION:
+*       returns default ADR limits
+*
+*********************************************************************/
+lora_adr_config lora_adr_default_config
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+lora_adr_config config;         /* default config         */
+
+/*----------------------------------------------------------
+10 dB installation margin matches common LoRa practice
+----------------------------------------------------------*/
+config.margin_db     = 10;
+config.hysteresis_db = 3;
+config.max_loss_pct  = 25;
+config.min_power_dbm = 2;
+config.max_power_dbm = 17;
+config.power_step_db = 3;
+config.min_sf        = LORA_SF_7;
+config.max_sf        = LORA_SF_12;
+config.min_bw        = LORA_BW_125_KHZ;
+config.max_bw        = LORA_BW_500_KHZ;
+
+return config;
+
+} /* lora_adr_default_config() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_init
+*
+*   DESCRIPTION:
+*       clears peer table and stores ADR limits
+*
+*********************************************************************/
+void lora_adr_init
+    (
+    lora_adr_config config                /* ADR tuning limits      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Store config and clear peers
+----------------------------------------------------------*/
+s_config = config;
+
+for( i = 0; i < LORA_ADR_MAX_PEERS; i++ )
+    {
+    s_peers[i].in_use = false;
+    adr_reset_window( &s_peers[i] );
+    }
+
+} /* lora_adr_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_add_peer
+*
+*   DESCRIPTION:
+*       starts tracking a peer. Returns false if table is full.
+*
+*********************************************************************/
+bool lora_adr_add_peer
+    (
+    uint8_t            peer,              /* peer address           */
+    lora_link_settings settings           /* starting link settings */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+adr_peer_state *state;          /* peer entry             */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Verify settings are in range
+----------------------------------------------------------*/
+if( settings.spreading_factor < LORA_SF_7  ||
+    settings.spreading_factor > LORA_SF_12 ||
+    settings.bandwidth > LORA_BW_500_KHZ   )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Reuse existing entry or find a free one
+----------------------------------------------------------*/
+state = adr_find_peer( peer );
+
+for( i = 0; state == NULL && i < LORA_ADR_MAX_PEERS; i++ )
+    {
+    if( !s_peers[i].in_use )
+        {
+        state = &s_peers[i];
+        }
+    }
+
+if( state == NULL )
+    {
+    return false;
+    }
+
+state->in_use   = true;
+state->peer     = peer;
+state->settings = settings;
+adr_reset_window( state );
+
+return true;
+
+} /* lora_adr_add_peer() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_report_rx
+*
+*   DESCRIPTION:
+*       records SNR of a packet heard from peer
+*
+*********************************************************************/
+void lora_adr_report_rx
+    (
+    uint8_t peer,                         /* peer address           */
+    int8_t  snr                           /* packet SNR in 0.25 dB  */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+adr_peer_state *state;          /* peer entry             */
+
+/*----------------------------------------------------------
+Accumulate sample
+----------------------------------------------------------*/
+state = adr_find_peer( peer );
+if( state == NULL || state->snr_count == UINT16_MAX )
+    {
+    return;
+    }
+
+state->snr_sum += snr;
+state->snr_count++;
+
+} /* lora_adr_report_rx() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_report_tx
+*
+*   DESCRIPTION:
+*       records if a packet sent to peer was delivered
+*
+*********************************************************************/
+void lora_adr_report_tx
+    (
+    uint8_t peer,                         /* peer address           */
+    bool    delivered                     /* packet was delivered   */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+adr_peer_state *state;          /* peer entry             */
+
+/*----------------------------------------------------------
+Accumulate sample
+----------------------------------------------------------*/
+state = adr_find_peer( peer );
+if( state == NULL || state->tx_count == UINT16_MAX )
+    {
+    return;
+    }
+
+state->tx_count++;
+if( !delivered )
+    {
+    state->lost_count++;
+    }
+
+} /* lora_adr_report_tx() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_evaluate
+*
+*   DESCRIPTION:
+*       once a full window of samples is collected, moves peer
+*       link settings at most one step and starts a new window.
+*       Link is stepped up if loss exceeds the limit or margin
+*       is negative, stepped down if margin covers the step plus
+*       hysteresis.
+*
+*********************************************************************/
+lora_adr_action lora_adr_evaluate
+    (
+    uint8_t peer                          /* peer address           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+adr_peer_state *state;          /* peer entry             */
+lora_adr_action action;         /* decision taken         */
+int32_t         margin;         /* SNR margin in 0.25 dB  */
+bool            high_loss;      /* loss over limit T/F    */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+action    = ADR_NO_CHANGE;
+margin    = 0;
+high_loss = false;
+
+/*----------------------------------------------------------
+Wait for a full window
+----------------------------------------------------------*/
+state = adr_find_peer( peer );
+if( state == NULL ||
+    ( state->snr_count + state->tx_count ) < LORA_ADR_WINDOW_SIZE )
+    {
+    return ADR_NO_CHANGE;
+    }
+
+/*----------------------------------------------------------
+Compute loss and margin over demodulation floor
+----------------------------------------------------------*/
+if( state->tx_count != 0 )
+    {
+    high_loss = ( ( (uint32_t)state->lost_count * PERCENT ) >
+                  ( (uint32_t)state->tx_count * s_config.max_loss_pct ) );
+    }
+
+if( state->snr_count != 0 )
+    {
+    margin = ( state->snr_sum / state->snr_count )
+           - s_snr_floor_qdb[state->settings.spreading_factor - LORA_SF_7]
+           - ( s_config.margin_db * QDB_PER_DB );
+    }
+
+/*----------------------------------------------------------
+Take at most one step
+----------------------------------------------------------*/
+if( high_loss || ( state->snr_count != 0 && margin < 0 ) )
+    {
+    if( adr_step_up( &state->settings ) )
+        {
+        action = ADR_STEP_UP;
+        }
+    }
+else if( state->snr_count != 0 )
+    {
+    if( adr_step_down( &state->settings, margin ) )
+        {
+        action = ADR_STEP_DOWN;
+        }
+    }
+
+adr_reset_window( state );
+
+return action;
+
+} /* lora_adr_evaluate() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_get_settings
+*
+*   DESCRIPTION:
+*       returns current link settings of peer
+*
+*********************************************************************/
+bool lora_adr_get_settings
+    (
+    uint8_t             peer,             /* peer address           */
+    lora_link_settings *settings          /* returned settings      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+adr_peer_state *state;          /* peer entry             */
+
+/*----------------------------------------------------------
+Look up peer
+----------------------------------------------------------*/
+state = adr_find_peer( peer );
+if( state == NULL )
+    {
+    return false;
+    }
+
+*settings = state->settings;
+
+return true;
+
+} /* lora_adr_get_settings() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_adr_apply
+*
+*   DESCRIPTION:
+*       writes link settings of peer to the radio, call before
+*       sending to that peer. lora_set_modem_config() skips the
+*       write when the modem settings are unchanged and resumes
+*       rx continious mode if the radio was receiving.
+*
+*********************************************************************/
+bool lora_adr_apply
+    (
+    uint8_t peer                          /* peer address           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+adr_peer_state *state;          /* peer entry             */
+
+/*----------------------------------------------------------
+Look up peer and program radio
+----------------------------------------------------------*/
+state = adr_find_peer( peer );
+if( state == NULL )
+    {
+    return false;
+    }
+
+if( !lora_set_modem_config( state->settings.spreading_factor,
+                            state->settings.bandwidth ) )
+    {
+    return false;
+    }
+
+return lora_set_tx_power( state->settings.power_dbm );
+
+} /* lora_adr_apply() */
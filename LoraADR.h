@@ -0,0 +1,128 @@
+/*********************************************************************
+*
+*   HEADER:
+*       header file for loraADR
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+#ifndef LORA_ADR_H
+#define LORA_ADR_H
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define LORA_ADR_MAX_PEERS      ( 8 )      /* peers tracked at once     */
+
+#define LORA_ADR_WINDOW_SIZE    ( 8 )      /* samples per decision      */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef uint8_t lora_adr_action;       /* ADR decision              */
+enum
+    {
+    ADR_NO_CHANGE,                    /* settings unchanged         */
+    ADR_STEP_UP,                      /* link made more robust      */
+    ADR_STEP_DOWN                     /* link made faster / quieter */
+    };
+
+typedef struct
+    {
+    lora_spreading_factor spreading_factor; /* spreading factor     */
+    lora_bandwidth        bandwidth;        /* signal bandwidth     */
+    int8_t                power_dbm;        /* tx power in dBm      */
+    } lora_link_settings;                   /* radio link settings  */
+
+typedef struct
+    {
+    int8_t                margin_db;        /* installation margin
+                                               kept above demod
+                                               floor                */
+    int8_t                hysteresis_db;    /* extra margin needed
+                                               before stepping down */
+    uint8_t               max_loss_pct;     /* loss above which link
+                                               is stepped up        */
+    int8_t                min_power_dbm;    /* lowest tx power      */
+    int8_t                max_power_dbm;    /* highest tx power     */
+    int8_t                power_step_db;    /* tx power step        */
+    lora_spreading_factor min_sf;           /* fastest SF allowed   */
+    lora_spreading_factor max_sf;           /* slowest SF allowed   */
+    lora_bandwidth        min_bw;           /* narrowest bandwidth  */
+    lora_bandwidth        max_bw;           /* widest bandwidth     */
+    } lora_adr_config;                      /* ADR tuning limits    */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+loraADR.c
+--------------------------------------------------------------------*/
+lora_adr_config lora_adr_default_config
+    (
+    void
+    );
+
+void lora_adr_init
+    (
+    lora_adr_config config                /* ADR tuning limits      */
+    );
+
+bool lora_adr_add_peer
+    (
+    uint8_t            peer,              /* peer address           */
+    lora_link_settings settings           /* starting link settings */
+    );
+
+void lora_adr_report_rx
+    (
+    uint8_t peer,                         /* peer address           */
+    int8_t  snr                           /* packet SNR in 0.25 dB  */
+    );
+
+void lora_adr_report_tx
+    (
+    uint8_t peer,                         /* peer address           */
+    bool    delivered                     /* packet was delivered   */
+    );
+
+lora_adr_action lora_adr_evaluate
+    (
+    uint8_t peer                          /* peer address           */
+    );
+
+bool lora_adr_get_settings
+    (
+    uint8_t             peer,             /* peer address           */
+    lora_link_settings *settings          /* returned settings      */
+    );
+
+bool lora_adr_apply
+    (
+    uint8_t peer                          /* peer address           */
+    );
+
+#endif /* LORA_ADR_H */
+
+/* LoraADR.h */
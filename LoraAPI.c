@@ -24,6 +24,7 @@
 #include "driverlib/pin_map.h"
 #include "driverlib/ssi.h"
 #include "driverlib/sysctl.h"
+#include "inc/hw_ints.h"
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/tm4c123gh6pm.h"
@@ -33,8 +34,6 @@
 /*--------------------------------------------------------------------
                           LITERAL CONSTANTS
 --------------------------------------------------------------------*/
-#define LORA_MAX_POWER_MODE     ( 0xFF )               /* max power output  */
-
 #define LORA_BASE_FIFO_ADD      ( 0x00 )               /* base fifo address */
 
 #define LORA_REGISTER_SELECT    ( 0x80 )               /* select lora
@@ -56,6 +55,8 @@
                                                        /* config register rx
                                                           continious mode   */
 
+#define LORA_FHSS_CHANGE_MASK   ( 0x02 )               /* hop channel mask  */
+
 #define LORA_TX_DONE_MASK       ( 0x08 )               /* tx done mask      */
 
 #define LORA_VALID_HEADER_MASK  ( 0x10 )               /* valid header mask */
@@ -76,6 +77,90 @@
 
 #define SPI_WRITE_DATA_FLAG     ( 0x80 )               /* SPI write flag    */
 
+#define LORA_PA_BOOST_SELECT    ( 0x80 )               /* PA_BOOST pin      */
+
+#define LORA_MAX_POWER_BITS     ( 0x70 )               /* max power 15dBm   */
+
+#define LORA_RFO_MIN_DBM        ( 0 )                  /* RFO min power     */
+
+#define LORA_RFO_MAX_DBM        ( 15 )                 /* RFO max power     */
+
+#define LORA_PA_BOOST_MIN_DBM   ( 2 )                  /* PA_BOOST min pwr  */
+
+#define LORA_PA_BOOST_MAX_DBM   ( 17 )                 /* PA_BOOST max pwr  */
+
+#define LORA_HIGH_POWER_MIN_DBM ( 5 )                  /* PaDac min power   */
+
+#define LORA_HIGH_POWER_MAX_DBM ( 20 )                 /* PaDac max power   */
+
+#define LORA_PA_DAC_DEFAULT     ( 0x84 )               /* PaDac normal mode */
+
+#define LORA_PA_DAC_HIGH_POWER  ( 0x87 )               /* PaDac +20dBm mode */
+
+#define LORA_PA_RAMP_MASK       ( 0x0F )               /* PaRamp bits       */
+
+#define LORA_OCP_ON             ( 0x20 )               /* OCP enable bit    */
+
+#define LORA_OCP_DEFAULT_TRIM   ( 0x0B )               /* 100mA trim        */
+
+#define LORA_OCP_MIN_MA         ( 45 )                 /* OCP min trip      */
+
+#define LORA_OCP_FINE_MAX_MA    ( 120 )                /* 5mA step limit    */
+
+#define LORA_OCP_MAX_MA         ( 240 )                /* OCP max trip      */
+
+#define LORA_HIGH_POWER_OCP_MA  ( 140 )                /* min OCP trip for
+                                                          +20 dBm PaDac     */
+
+#define LORA_UPPER_NIBBLE_SHIFT ( 4 )                  /* SF / BW bit shift */
+
+#define LORA_LOWER_NIBBLE_MASK  ( 0x0F )               /* keep CR, header,
+                                                          CRC and timeout
+                                                          bits              */
+
+#define LORA_LOW_DR_OPT_MASK    ( 0x08 )               /* low data rate
+                                                          optimize bit      */
+
+#define LORA_LOW_DR_SYMBOL_US   ( 16000 )              /* symbol time that
+                                                          requires low data
+                                                          rate optimize     */
+
+#define LORA_PREAMBLE_QSYMBOLS  ( 49 )                 /* 8 symbol preamble
+                                                          + 4.25 sync, in
+                                                          quarter symbols   */
+
+#define LORA_CODING_RATE        ( 1 )                  /* 4/5 (reset value) */
+
+#define LORA_CRC_BITS           ( 16 )                 /* payload CRC size  */
+
+#define LORA_HOP_CHANNEL_MASK   ( 0x3F )               /* FhssPresentChannel
+                                                          bits              */
+
+#define LORA_MIN_HOP_TIME_US    ( 1000 )               /* shortest hop the
+                                                          interrupt path can
+                                                          service           */
+
+#define LORA_DIO2_MAPPING_MASK  ( 0x0C )               /* DIO2 mapping bits,
+                                                          00 -->
+                                                          FhssChangeChannel */
+
+#define LORA_XOSC_HZ            ( 32000000ULL )        /* crystal frequency */
+
+#define LORA_FRF_SHIFT          ( 19 )                 /* Frf = f * 2^19 /
+                                                          Fxosc             */
+
+#define LORA_DEFAULT_FRF        ( 0x6C8000 )           /* 434 MHz (reset)   */
+
+#define LORA_MODE_DELAY_LOOPS   ( 2000000 )            /* SysCtlDelay count
+                                                          after an OP_MODE
+                                                          write             */
+
+#define SYSCTL_DELAY_CYCLES     ( 3 )                  /* cycles per
+                                                          SysCtlDelay loop  */
+
+#define LORA_RX_INIT_MODE_WRITES ( 2 )                 /* OP_MODE writes in
+                                                          rx init           */
+
 /*--------------------------------------------------------------------
                                 TYPES
 --------------------------------------------------------------------*/
@@ -96,8 +181,13 @@ typedef uint8_t lora_registers; /* lora registers                   */
 enum
     {
     LORA_REGISTER_OP_MODE = 0x01,  /* operating modes register      */
+    LORA_FRF_MSB          = 0x06,  /* carrier frequency bits 23-16  */
+    LORA_FRF_MID          = 0x07,  /* carrier frequency bits 15-8   */
+    LORA_FRF_LSB          = 0x08,  /* carrier frequency bits 7-0    */
     LORA_REGISTER_FIFO    = 0x00,  /* fifo register                 */
     LORA_REGISTER_POWER   = 0x09,  /* power configuration register  */
+    LORA_PA_RAMP          = 0x0A,  /* PA ramp time register         */
+    LORA_OCP              = 0x0B,  /* over current protection       */
     LORA_FIFO_ADDR_PTR    = 0x0D,  /* pointer to fifo buffer        */
     LORA_TX_FIFO_ADDR     = 0x0E,  /* base addrees for tx fifo      */
     LORA_RX_FIFO_ADDR     = 0x0F,  /* base address for rx fifo      */
@@ -106,12 +196,74 @@ enum
     LORA_FLAGS_MASK       = 0x11,  /* masks for flag register       */
     LORA_REGISTER_FLAGS   = 0x12,  /* flags register                */
     LORA_RX_COUNT         = 0x13,  /* rx byte count register        */
-    LORA_PAYLOAD_SIZE     = 0x22   /* rx payload size register      */
+    LORA_PKT_SNR_VALUE    = 0x19,  /* SNR of last packet register   */
+    LORA_HOP_CHANNEL      = 0x1C,  /* present FHSS channel          */
+    LORA_MODEM_CONFIG_1   = 0x1D,  /* bandwidth / coding rate       */
+    LORA_MODEM_CONFIG_2   = 0x1E,  /* spreading factor / CRC        */
+    LORA_PAYLOAD_SIZE     = 0x22,  /* rx payload size register      */
+    LORA_HOP_PERIOD       = 0x24,  /* symbols per FHSS hop, 0 off   */
+    LORA_MODEM_CONFIG_3   = 0x26,  /* low data rate optimize / AGC  */
+    LORA_DIO_MAPPING_1    = 0x40,  /* DIO0 - DIO3 signal mapping    */
+    LORA_PA_DAC           = 0x4D   /* PA high power register        */
            
     };
+typedef struct
+    {
+    bool     enabled;                     /* filter in use          */
+    uint16_t address;                     /* address to accept      */
+    uint16_t mask;                        /* address bits compared  */
+    } lora_address_filter;                /* address filter entry   */
+
 /*--------------------------------------------------------------------
                            MEMORY CONSTANTS
 --------------------------------------------------------------------*/
+static const uint32_t s_bandwidth_hz[] =   /* bandwidth in Hz indexed
+                                              by lora_bandwidth         */
+    {
+    7800,
+    10400,
+    15600,
+    20800,
+    31250,
+    41700,
+    62500,
+    125000,
+    250000,
+    500000
+    };
+
+static const uint32_t s_gpio_base[] =      /* GPIO base indexed by
+                                              CS_port                   */
+    {
+    GPIO_PORTA_BASE,
+    GPIO_PORTB_BASE,
+    GPIO_PORTC_BASE,
+    GPIO_PORTD_BASE,
+    GPIO_PORTE_BASE,
+    GPIO_PORTF_BASE
+    };
+
+static const uint32_t s_gpio_periph[] =    /* GPIO peripheral indexed
+                                              by CS_port                */
+    {
+    SYSCTL_PERIPH_GPIOA,
+    SYSCTL_PERIPH_GPIOB,
+    SYSCTL_PERIPH_GPIOC,
+    SYSCTL_PERIPH_GPIOD,
+    SYSCTL_PERIPH_GPIOE,
+    SYSCTL_PERIPH_GPIOF
+    };
+
+static const uint32_t s_gpio_int[] =       /* GPIO interrupt indexed by
+                                              CS_port                   */
+    {
+    INT_GPIOA,
+    INT_GPIOB,
+    INT_GPIOC,
+    INT_GPIOD,
+    INT_GPIOE,
+    INT_GPIOF
+    };
 
 /*--------------------------------------------------------------------
                               VARIABLES
@@ -121,6 +273,46 @@ static uint8_t s_data_pin         = NULL;  /* SPI pin selected          */
 //static uint8_t s_data_port  = NULL;      /* SPI port selected         */
 #define s_data_port      ( GPIO_PORTA_DATA_R ) /* SPI CS Port           */
 static bool s_port_inited         = false; /* Port selected T/F         */
+static lora_spreading_factor s_spreading_factor = LORA_SF_7;
+                                           /* current spreading factor  */
+static lora_bandwidth s_bandwidth = LORA_BW_125_KHZ;
+                                           /* current bandwidth         */
+static bool s_modem_configured    = false; /* modem config written T/F  */
+static uint8_t s_address_size     = 0;     /* address header bytes,
+                                              0 when not filtering      */
+static uint16_t s_destination     = LORA_BROADCAST_ADDRESS;
+                                           /* address of sent frames    */
+static lora_address_filter s_address_filters[LORA_MAX_ADDRESS_FILTERS];
+                                           /* node / group filters      */
+static lora_filter_stats s_filter_stats;   /* filter counters           */
+static uint32_t s_frf                = LORA_DEFAULT_FRF;
+                                           /* current Frf register value*/
+static uint32_t s_hop_frf[LORA_MAX_HOP_CHANNELS];
+                                           /* FHSS table as Frf values  */
+static uint8_t s_hop_channels        = 0;  /* FHSS channels, 0 when off */
+static uint8_t s_hop_period          = 0;  /* symbols per hop           */
+static uint32_t s_dio2_base          = 0;  /* GPIO base DIO2 is wired to*/
+static uint8_t s_dio2_pin            = 0;  /* GPIO pin DIO2 is wired to */
+static uint32_t (*s_time_source)( void ) = NULL;
+                                           /* microsecond timer read    */
+static bool (*s_tx_gate)( uint8_t number_of_bytes ) = NULL;
+                                           /* checked before every tx   */
+static uint8_t s_loaded_bytes        = 0;  /* message bytes in tx fifo  */
+static volatile uint32_t s_dio0_time_us = 0;
+                                           /* time of last DIO0 edge    */
+static volatile bool s_dio0_time_valid = false;
+                                           /* DIO0 edge not consumed    */
+static uint32_t s_tx_start_us        = 0;  /* time tx mode was set      */
+static uint32_t s_tx_done_us         = 0;  /* time of last TxDone       */
+static uint32_t s_rx_done_us         = 0;  /* time of last RxDone       */
+static lora_power_config s_power_config =  /* tx power settings         */
+    {
+    LORA_PA_BOOST,                         /* PA_BOOST pin              */
+    LORA_PA_BOOST_MAX_DBM,                 /* 17 dBm                    */
+    false,                                 /* normal PaDac              */
+    100,                                   /* 100mA OCP (reset value)   */
+    LORA_PA_RAMP_40_US                     /* 40us ramp (reset value)   */
+    };
 
 /*--------------------------------------------------------------------
                                 MACROS
@@ -140,6 +332,37 @@ void loRa_write_register
     uint8_t         register_data               /* register data    */
     );
 
+static bool lora_pa_config_value
+    (
+    lora_power_config config,                   /* tx power settings */
+    uint8_t          *pa_config                 /* RegPaConfig value */
+    );
+
+static bool lora_write_power_config
+    (
+    void
+    );
+
+static bool lora_match_address
+    (
+    uint8_t header[]                            /* address bytes    */
+    );
+
+static void lora_write_frf
+    (
+    uint32_t frf                                /* Frf value        */
+    );
+
+static bool lora_write_hop_config
+    (
+    void
+    );
+
+static uint32_t lora_take_dio0_time
+    (
+    void
+    );
+
 /*********************************************************************
 *
 *   PROCEDURE NAME:
@@ -159,6 +382,7 @@ Local variables
 ----------------------------------------------------------*/
 uint32_t    message_return;  /* value of register             */
 uint8_t     number_in_fifo;  /* how many items remain in fifo */
+bool        int_disabled;    /* interrupts already off T/F    */
 
 /*----------------------------------------------------------
 Initilize local variables
@@ -166,6 +390,11 @@ Initilize local variables
 message_return   = 0x00;
 number_in_fifo   = 0xFF;
 
+/*----------------------------------------------------------
+Keep the FHSS interrupt out of the transaction
+----------------------------------------------------------*/
+int_disabled = IntMasterDisable();
+
 /*----------------------------------------------------------
 Read from fifo until empty
 ----------------------------------------------------------*/
@@ -206,6 +435,11 @@ Pull from fifo and toggle CS
 SSIDataGet( s_spi_selected, &message_return );
 s_data_port |= s_data_pin;
 
+if( !int_disabled )
+    {
+    IntMasterEnable();
+    }
+
 return message_return;
 
 } /* loRa_read_register() */
@@ -230,6 +464,7 @@ Local variables
 ----------------------------------------------------------*/
 uint32_t    message_return;  /* value of register             */
 uint8_t     number_in_fifo;  /* how many items remain in fifo */
+bool        int_disabled;    /* interrupts already off T/F    */
 
 /*----------------------------------------------------------
 Initilize local variables
@@ -237,6 +472,11 @@ Initilize local variables
 message_return   = 0x00;
 number_in_fifo   = 0xFF;
 
+/*----------------------------------------------------------
+Keep the FHSS interrupt out of the transaction
+----------------------------------------------------------*/
+int_disabled = IntMasterDisable();
+
 /*----------------------------------------------------------
 Read from fifo until empty
 ----------------------------------------------------------*/
@@ -274,12 +514,17 @@ Toggle CS
 ----------------------------------------------------------*/
 s_data_port |= s_data_pin;
 
+if( !int_disabled )
+    {
+    IntMasterEnable();
+    }
+
 /*----------------------------------------------------------
 Add delay if changing modes since this takes longer
 ----------------------------------------------------------*/
 if ( register_address == LORA_REGISTER_OP_MODE )
 	{
-	SysCtlDelay(2000000);
+	SysCtlDelay( LORA_MODE_DELAY_LOOPS );
 	}
 
 	
@@ -288,52 +533,75 @@ if ( register_address == LORA_REGISTER_OP_MODE )
 /*********************************************************************
 *
 *   PROCEDURE NAME:
-*       lora_port_init
+*       lora_pa_config_value
 *
 *   DESCRIPTION:
-*       initize port used for LoRa data tranmission 
+*       verifies power is in range for the selected PA and
+*       builds the RegPaConfig value
 *
 *********************************************************************/
-void lora_port_init
+static bool lora_pa_config_value
     (
-    lora_config config_data                  /* SPI Interface info  */
+    lora_power_config config,                   /* tx power settings */
+    uint8_t          *pa_config                 /* RegPaConfig value */
     )
 {
 /*----------------------------------------------------------
-Initilize static variables
-----------------------------------------------------------*/
-s_spi_selected = config_data.SSI_BASE;
-s_data_pin = config_data.SSI_PIN;
-
-/*----------------------------------------------------------
-Verify port A selected for CS as it is the only port
-currently supported
+RegPaConfig bit defintions:
+    0-3 - output power
+    4-6 - max power (RFO only, 7 --> 15 dBm)
+    7   - PA select (RFO/PA_BOOST)
+
+RFO      output power = OutputPower
+PA_BOOST output power = 2 dBm + OutputPower
+PaDac    output power = 5 dBm + OutputPower
 ----------------------------------------------------------*/
-if( config_data.SSI_PORT != PORT_A )
+if( config.pa_select == LORA_PA_RFO )
     {
-    s_port_inited = false;
-    return;
+    if( config.high_power                   ||
+        config.power_dbm < LORA_RFO_MIN_DBM ||
+        config.power_dbm > LORA_RFO_MAX_DBM )
+        {
+        return false;
+        }
+    *pa_config = LORA_MAX_POWER_BITS | ( config.power_dbm - LORA_RFO_MIN_DBM );
+    }
+else if( config.high_power )
+    {
+    if( config.power_dbm < LORA_HIGH_POWER_MIN_DBM ||
+        config.power_dbm > LORA_HIGH_POWER_MAX_DBM )
+        {
+        return false;
+        }
+    *pa_config = LORA_PA_BOOST_SELECT | LORA_MAX_POWER_BITS |
+                 ( config.power_dbm - LORA_HIGH_POWER_MIN_DBM );
+    }
+else
+    {
+    if( config.power_dbm < LORA_PA_BOOST_MIN_DBM ||
+        config.power_dbm > LORA_PA_BOOST_MAX_DBM )
+        {
+        return false;
+        }
+    *pa_config = LORA_PA_BOOST_SELECT | LORA_MAX_POWER_BITS |
+                 ( config.power_dbm - LORA_PA_BOOST_MIN_DBM );
     }
 
-/*----------------------------------------------------------
-Set port init variable to true for other functions
-----------------------------------------------------------*/
-s_port_inited = true;
-
-}
+return true;
 
+} /* lora_pa_config_value() */
 
 /*********************************************************************
 *
 *   PROCEDURE NAME:
-*       lora_init_tx
+*       lora_write_power_config
 *
 *   DESCRIPTION:
-*       runs the proper steps to initilize lora into TX 
-*       continious mode
+*       writes stored power config to the PA registers and
+*       verifies
 *
 *********************************************************************/
-bool lora_init_tx
+static bool lora_write_power_config
     (
     void
     )
@@ -341,389 +609,787 @@ bool lora_init_tx
 /*----------------------------------------------------------
 Local variables
 ----------------------------------------------------------*/
-uint8_t config_register_data; /* configuration data       */
-uint8_t tx_fifo_ptr;          /* tx fifo pointer          */
-uint8_t return_value_verify;  /* verification value       */
-uint8_t power_modes;          /* power modes data         */
+uint8_t pa_config;            /* RegPaConfig data         */
+uint8_t register_data;        /* register data            */
 
 /*----------------------------------------------------------
-Initilize local/static variables
+Initilize local variables
 ----------------------------------------------------------*/
-/*--------------------------------
-config register bit defintions:
-    0-2 - operating mode
-    3   - frequency register select
-    4-5 - reserved
-    6   - Register select (Lora/FSK)
-    7   - long range mode (Lora/FSK)
-
-0x80 --> LoRa mode, sleep mode 
---------------------------------*/
-config_register_data  = LORA_SLEEP_MODE;
-tx_fifo_ptr           = 0x00;
-return_value_verify   = 0x00;
-power_modes           = 0x00;
+pa_config     = 0x00;
+register_data = 0x00;
 
-/*----------------------------------------------------------
-Verify port selection has been made 
-----------------------------------------------------------*/
-if ( !s_port_inited )
+if( !lora_pa_config_value( s_power_config, &pa_config ) )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Configure into LoRa sleep mode and verify
+Configure over current protection and verify
+
+Imax = 45 + 5 * OcpTrim    for 45 to 120 mA
+Imax = -30 + 10 * OcpTrim  for 130 to 240 mA
 ----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_OP_MODE, config_register_data );
+if( s_power_config.ocp_ma == 0 )
+    {
+    register_data = LORA_OCP_DEFAULT_TRIM;
+    }
+else if( s_power_config.ocp_ma <= LORA_OCP_FINE_MAX_MA )
+    {
+    register_data = LORA_OCP_ON | ( ( s_power_config.ocp_ma - LORA_OCP_MIN_MA ) / 5 );
+    }
+else
+    {
+    register_data = LORA_OCP_ON | ( ( s_power_config.ocp_ma + 30 ) / 10 );
+    }
 
-config_register_data = loRa_read_register( LORA_REGISTER_OP_MODE ); 
+loRa_write_register( LORA_OCP, register_data );
 
-if ( config_register_data != LORA_SLEEP_MODE )
+if( loRa_read_register( LORA_OCP ) != register_data )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Configure high power TX mode and verify
+Configure PA ramp and verify
 ----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_POWER, LORA_MAX_POWER_MODE );
-power_modes = loRa_read_register( LORA_REGISTER_POWER );
+register_data = loRa_read_register( LORA_PA_RAMP );
+register_data = ( register_data & ~LORA_PA_RAMP_MASK ) | s_power_config.pa_ramp;
+loRa_write_register( LORA_PA_RAMP, register_data );
 
-if( power_modes != LORA_MAX_POWER_MODE )
+if( loRa_read_register( LORA_PA_RAMP ) != register_data )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Configure TX fifo pointers and verify
-
-Register 0x00 (fifo) can be configured to point to specific
-sections of the fifo buffer. By default tx points to 0x80.
-three registers control this function:
-    - LORA_FIFO_ADDR_PTR: address register 0x00 points to
-    - LORA_TX_FIFO_ADDR: address where TX data starts
-    - LORA_RX_FIFO_ADDR: address where RX data starts
-
-In case LORA_TX_FIFO_ADDR is modified, we always read it
-and set LORA_FIFO_ADDR_PTR accordingly.
+Configure PaDac and verify
 ----------------------------------------------------------*/
-tx_fifo_ptr = loRa_read_register ( LORA_TX_FIFO_ADDR );
-loRa_write_register( LORA_FIFO_ADDR_PTR, tx_fifo_ptr );
+register_data = s_power_config.high_power ? LORA_PA_DAC_HIGH_POWER : LORA_PA_DAC_DEFAULT;
+loRa_write_register( LORA_PA_DAC, register_data );
 
-return_value_verify = loRa_read_register( LORA_FIFO_ADDR_PTR );
-if( tx_fifo_ptr != return_value_verify )
+if( loRa_read_register( LORA_PA_DAC ) != register_data )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Set into TX mode and verify
-
-NOTE:
-    We very mode is TX or Standby as after a succuessfull tx,
-		we will enter standby mode
+Configure output power and verify
 ----------------------------------------------------------*/
-loRa_write_register(LORA_REGISTER_OP_MODE, LORA_TX_MODE);
-return_value_verify = loRa_read_register( LORA_REGISTER_OP_MODE );
-		
-if( return_value_verify !=  LORA_TX_MODE && 
-    return_value_verify !=  LORA_STBY_MODE  )
+loRa_write_register( LORA_REGISTER_POWER, pa_config );
+
+if( loRa_read_register( LORA_REGISTER_POWER ) != pa_config )
     {
     return false;
     }
-		
+
 return true;
-} /* lora_init_tx() */
+
+} /* lora_write_power_config() */
 
 /*********************************************************************
 *
 *   PROCEDURE NAME:
-*       lora_init_continious_rx
+*       lora_match_address
 *
 *   DESCRIPTION:
-*       runs the proper steps to initilize lora into RX 
-*       continious mode
+*       compares address header (MSB first) against enabled
+*       filters and counts the first hit. Filters are cut to
+*       the header size, as addresses are on air, so a 16 bit
+*       broadcast filter matches 1 byte broadcast.
 *
 *********************************************************************/
-bool lora_init_continious_rx
+static bool lora_match_address
     (
-    void
+    uint8_t header[]                            /* address bytes    */
     )
 {
 /*----------------------------------------------------------
 Local variables
 ----------------------------------------------------------*/
-uint8_t config_register_data; /* configuration data       */
-uint8_t rx_fifo_ptr;          /* rx fifo pointer          */
-uint8_t return_value_verify;  /* verification value       */
-uint8_t power_modes;          /* power modes data         */
+uint16_t address;               /* received address       */
+uint16_t width_mask;            /* bits in the header     */
+uint16_t mask;                  /* filter bits compared   */
+int i;                          /* interator              */
 
 /*----------------------------------------------------------
-Initilize local/static variables
+Initilize local variables
 ----------------------------------------------------------*/
-/*--------------------------------
-config register bit defintions:
-    0-2 - operating mode
-    3   - frequency register select
-    4-5 - reserved
-    6   - Register select (Lora/FSK)
-    7   - long range mode (Lora/FSK)
+address    = 0;
+width_mask = (uint16_t)( ( 1UL << ( 8 * s_address_size ) ) - 1 );
 
-0x80 --> LoRa mode, sleep mode 
---------------------------------*/
-config_register_data  = LORA_SLEEP_MODE;
-rx_fifo_ptr           = 0x00;
-return_value_verify   = 0x00;
-power_modes           = 0x00;
+for( i = 0; i < s_address_size; i++ )
+    {
+    address = ( address << 8 ) | header[i];
+    }
 
 /*----------------------------------------------------------
-Verify port selection has been made 
+Check filters
 ----------------------------------------------------------*/
-if ( !s_port_inited )
+for( i = 0; i < LORA_MAX_ADDRESS_FILTERS; i++ )
     {
-    return false;
+    mask = s_address_filters[i].mask & width_mask;
+
+    if( s_address_filters[i].enabled &&
+        ( address & mask ) == ( s_address_filters[i].address & mask ) )
+        {
+        s_filter_stats.hits[i]++;
+        return true;
+        }
     }
 
+return false;
+
+} /* lora_match_address() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_write_frf
+*
+*   DESCRIPTION:
+*       writes carrier frequency registers. New frequency takes
+*       effect on the LSB write. The FHSS interrupt is held off
+*       so it cannot retune between the three writes.
+*
+*********************************************************************/
+static void lora_write_frf
+    (
+    uint32_t frf                                /* Frf value        */
+    )
+{
 /*----------------------------------------------------------
-Configure into LoRa sleep mode and verify
+Local variables
 ----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_OP_MODE, config_register_data );
-		
-config_register_data = loRa_read_register( LORA_REGISTER_OP_MODE );		
+bool int_disabled;              /* interrupts already off */
 
-if ( config_register_data != LORA_SLEEP_MODE )
+int_disabled = IntMasterDisable();
+
+loRa_write_register( LORA_FRF_MSB, (uint8_t)( frf >> 16 ) );
+loRa_write_register( LORA_FRF_MID, (uint8_t)( frf >> 8 ) );
+loRa_write_register( LORA_FRF_LSB, (uint8_t)( frf ) );
+
+s_frf = frf;
+
+if( !int_disabled )
     {
-    return false;
+    IntMasterEnable();
     }
 
-/*----------------------------------------------------------
-Configure high power TX mode and verify
-----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_POWER, LORA_MAX_POWER_MODE );
-power_modes = loRa_read_register( LORA_REGISTER_POWER );
+} /* lora_write_frf() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_write_hop_config
+*
+*   DESCRIPTION:
+*       writes hop period and, when hopping, tunes to the first
+*       hop channel where every packet starts
+*
+*********************************************************************/
+static bool lora_write_hop_config
+    (
+    void
+    )
+{
+loRa_write_register( LORA_HOP_PERIOD, s_hop_period );
 
-if( power_modes != LORA_MAX_POWER_MODE )
+if( loRa_read_register( LORA_HOP_PERIOD ) != s_hop_period )
     {
     return false;
     }
 
-/*----------------------------------------------------------
-Configure RX fifo pointers and verify
+if( s_hop_channels != 0 )
+    {
+    lora_write_frf( s_hop_frf[0] );
+    }
 
-Register 0x00 (fifo) can be configured to point to specific
-sections of the fifo buffer. By default rx points to 0x00.
-three registers control this function:
-    - LORA_FIFO_ADDR_PTR: address register 0x00 points to
-    - LORA_TX_FIFO_ADDR: address where TX data starts
-    - LORA_RX_FIFO_ADDR: address where RX data starts
+return true;
 
-In case LORA_RX_FIFO_ADDR is modified, we always read it
-and set LORA_FIFO_ADDR_PTR accordingly.
-----------------------------------------------------------*/
-rx_fifo_ptr = loRa_read_register ( LORA_RX_FIFO_ADDR );
-loRa_write_register( LORA_FIFO_ADDR_PTR, rx_fifo_ptr );
+} /* lora_write_hop_config() */
 
-return_value_verify = loRa_read_register( LORA_FIFO_ADDR_PTR );
-if( rx_fifo_ptr != return_value_verify )
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_take_dio0_time
+*
+*   DESCRIPTION:
+*       returns time captured by lora_dio0_isr() if one is
+*       pending, otherwise the current time
+*
+*********************************************************************/
+static uint32_t lora_take_dio0_time
+    (
+    void
+    )
+{
+if( s_dio0_time_valid )
     {
-    return false;
+    s_dio0_time_valid = false;
+    return s_dio0_time_us;
     }
 
+return lora_get_time_us();
+
+} /* lora_take_dio0_time() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_port_init
+*
+*   DESCRIPTION:
+*       initize port used for LoRa data tranmission 
+*
+*********************************************************************/
+void lora_port_init
+    (
+    lora_config config_data                  /* SPI Interface info  */
+    )
+{
 /*----------------------------------------------------------
-Set into RX continious mode and verify 
+Initilize static variables
 ----------------------------------------------------------*/
-loRa_write_register(LORA_REGISTER_OP_MODE, LORA_RX_CONT_MODE);
-return_value_verify = loRa_read_register( LORA_REGISTER_OP_MODE );
+s_spi_selected = config_data.SSI_BASE;
+s_data_pin = config_data.SSI_PIN;
 
-if( return_value_verify !=  LORA_RX_CONT_MODE )
+/*----------------------------------------------------------
+Verify port A selected for CS as it is the only port
+currently supported
+----------------------------------------------------------*/
+if( config_data.SSI_PORT != PORT_A )
     {
-    return false;
+    s_port_inited = false;
+    return;
     }
 
-return true;
+/*----------------------------------------------------------
+Set port init variable to true for other functions
+----------------------------------------------------------*/
+s_port_inited = true;
+
+}
 
-} /* lora_init_continious_rx() */
 
 /*********************************************************************
 *
 *   PROCEDURE NAME:
-*       lora_send_message
+*       lora_init_tx
 *
 *   DESCRIPTION:
-*       send message
+*       runs the proper steps to initilize lora into TX 
+*       continious mode
 *
 *********************************************************************/
-bool lora_send_message
+bool lora_init_tx
     (
-    uint8_t Message[],                    /* array of bytes to send */
-    uint8_t number_of_bytes               /* size of array          */
+    void
     )
 {
 /*----------------------------------------------------------
 Local variables
 ----------------------------------------------------------*/
-uint8_t fifo_ptr_address;       /* fifo pointer address   */
-int i;                          /* interator              */
+uint8_t config_register_data; /* configuration data       */
+uint8_t tx_fifo_ptr;          /* tx fifo pointer          */
+uint8_t return_value_verify;  /* verification value       */
 
 /*----------------------------------------------------------
-Initilize local variables
+Initilize local/static variables
 ----------------------------------------------------------*/
-fifo_ptr_address      = 0x00;
-i                     = 0x00;
-	
+/*--------------------------------
+config register bit defintions:
+    0-2 - operating mode
+    3   - frequency register select
+    4-5 - reserved
+    6   - Register select (Lora/FSK)
+    7   - long range mode (Lora/FSK)
+
+0x80 --> LoRa mode, sleep mode 
+--------------------------------*/
+config_register_data  = LORA_SLEEP_MODE;
+tx_fifo_ptr           = 0x00;
+return_value_verify   = 0x00;
+
 /*----------------------------------------------------------
-Put into standby mode to fill fifo
+Verify port selection has been made 
 ----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_OP_MODE, LORA_STBY_MODE);
+if ( !s_port_inited )
+    {
+    return false;
+    }
 
 /*----------------------------------------------------------
-Reset TX fifo 
+Configure into LoRa sleep mode and verify
 ----------------------------------------------------------*/
-fifo_ptr_address = loRa_read_register( LORA_TX_FIFO_ADDR );
+loRa_write_register( LORA_REGISTER_OP_MODE, config_register_data );
 
-loRa_write_register( LORA_FIFO_ADDR_PTR, fifo_ptr_address );
+config_register_data = loRa_read_register( LORA_REGISTER_OP_MODE ); 
 
-if( loRa_read_register( LORA_FIFO_ADDR_PTR ) != fifo_ptr_address )
+if ( config_register_data != LORA_SLEEP_MODE )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Fill in fifo
+Configure TX power from lora_set_power_config() and verify
 ----------------------------------------------------------*/
-for( i = 0; i < number_of_bytes; i++ )
+if( !lora_write_power_config() )
     {
-    loRa_write_register( LORA_REGISTER_FIFO, Message[i] );
+    return false;
     }
 
 /*----------------------------------------------------------
-Set payload length to numBytes and verify
+Configure frequency hopping and verify
 ----------------------------------------------------------*/
-loRa_write_register( LORA_PAYLOAD_SIZE, number_of_bytes );
-
-if( loRa_read_register( LORA_PAYLOAD_SIZE ) != number_of_bytes )
+if( !lora_write_hop_config() )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Set into TX mode
+Configure TX fifo pointers and verify
+
+Register 0x00 (fifo) can be configured to point to specific
+sections of the fifo buffer. By default tx points to 0x80.
+three registers control this function:
+    - LORA_FIFO_ADDR_PTR: address register 0x00 points to
+    - LORA_TX_FIFO_ADDR: address where TX data starts
+    - LORA_RX_FIFO_ADDR: address where RX data starts
+
+In case LORA_TX_FIFO_ADDR is modified, we always read it
+and set LORA_FIFO_ADDR_PTR accordingly.
 ----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_OP_MODE, LORA_TX_MODE );
+tx_fifo_ptr = loRa_read_register ( LORA_TX_FIFO_ADDR );
+loRa_write_register( LORA_FIFO_ADDR_PTR, tx_fifo_ptr );
 
-if( loRa_read_register( LORA_REGISTER_OP_MODE ) != LORA_TX_MODE )
+return_value_verify = loRa_read_register( LORA_FIFO_ADDR_PTR );
+if( tx_fifo_ptr != return_value_verify )
     {
     return false;
     }
 
 /*----------------------------------------------------------
-Wait for TX to complete
-----------------------------------------------------------*/
-while( ( loRa_read_register( LORA_REGISTER_FLAGS ) & LORA_TX_DONE_MASK ) != LORA_TX_DONE_MASK )
-    {
-    }
-/*----------------------------------------------------------
-Clear IRQ flags
-----------------------------------------------------------*/
-loRa_write_register( LORA_REGISTER_FLAGS, LORA_TX_DONE_MASK );
+Set into TX mode and verify
 
-if( loRa_read_register( LORA_REGISTER_FLAGS ) != 0x00 )
+NOTE:
+    We very mode is TX or Standby as after a succuessfull tx,
+		we will enter standby mode
+----------------------------------------------------------*/
+loRa_write_register(LORA_REGISTER_OP_MODE, LORA_TX_MODE);
+return_value_verify = loRa_read_register( LORA_REGISTER_OP_MODE );
+		
+if( return_value_verify !=  LORA_TX_MODE && 
+    return_value_verify !=  LORA_STBY_MODE  )
     {
     return false;
     }
-
+		
 return true;
-
-} /* lora_send_message() */
+} /* lora_init_tx() */
 
 /*********************************************************************
 *
 *   PROCEDURE NAME:
-*       lora_get_message
+*       lora_init_continious_rx
 *
 *   DESCRIPTION:
-*       recive message
+*       runs the proper steps to initilize lora into RX 
+*       continious mode
 *
 *********************************************************************/
-bool lora_get_message
+bool lora_init_continious_rx
     (
-    uint8_t *message,                  /* pointer to return message */
-    uint8_t size_of_message,           /* array size of message[]   */
-    uint8_t *size,                     /* size of return message    */
-    lora_errors *error                 /* pointer to error variable */
+    void
     )
 {
 /*----------------------------------------------------------
 Local variables
 ----------------------------------------------------------*/
-uint8_t flag_register_data;      /* data of flag register */
-uint8_t rx_fifo_ptr;             /* rx fifo pointer       */
-int i;                           /* interator             */
+uint8_t config_register_data; /* configuration data       */
+uint8_t rx_fifo_ptr;          /* rx fifo pointer          */
+uint8_t return_value_verify;  /* verification value       */
 
 /*----------------------------------------------------------
-Initilize local variables
+Initilize local/static variables
 ----------------------------------------------------------*/
-flag_register_data  = 0x00;
-rx_fifo_ptr         = 0x00;
-i                   = 0x00;
+/*--------------------------------
+config register bit defintions:
+    0-2 - operating mode
+    3   - frequency register select
+    4-5 - reserved
+    6   - Register select (Lora/FSK)
+    7   - long range mode (Lora/FSK)
 
-/*----------------------------------------------------------
-Initilize variables
-----------------------------------------------------------*/
-*error    = RX_NO_ERROR;
-*size           = 0;
+0x80 --> LoRa mode, sleep mode 
+--------------------------------*/
+config_register_data  = LORA_SLEEP_MODE;
+rx_fifo_ptr           = 0x00;
+return_value_verify   = 0x00;
 
 /*----------------------------------------------------------
-Determine status of Rx
+Verify port selection has been made 
 ----------------------------------------------------------*/
-flag_register_data = loRa_read_register( LORA_REGISTER_FLAGS );
+if ( !s_port_inited )
+    {
+    return false;
+    }
 
 /*----------------------------------------------------------
-Determine if error is present
+Configure into LoRa sleep mode and verify
 ----------------------------------------------------------*/
+loRa_write_register( LORA_REGISTER_OP_MODE, config_register_data );
+		
+config_register_data = loRa_read_register( LORA_REGISTER_OP_MODE );		
 
-if ( ( flag_register_data & LORA_CRC_ERROR_MASK ) == LORA_CRC_ERROR_MASK )
+if ( config_register_data != LORA_SLEEP_MODE )
     {
-    *error = RX_CRC_ERROR;
+    return false;
     }
-else if ( ( flag_register_data & LORA_RX_TIMEOUT_MASK ) == LORA_RX_TIMEOUT_MASK )
+
+/*----------------------------------------------------------
+Configure frequency hopping and verify
+----------------------------------------------------------*/
+if( !lora_write_hop_config() )
     {
-    *error = RX_TIMEOUT;
+    return false;
     }
+
 /*----------------------------------------------------------
-If errors are present, clear
+Configure RX fifo pointers and verify
 
--------->>>>>>NEED TO VERIFY single write does not clear all flags
+Register 0x00 (fifo) can be configured to point to specific
+sections of the fifo buffer. By default rx points to 0x00.
+three registers control this function:
+    - LORA_FIFO_ADDR_PTR: address register 0x00 points to
+    - LORA_TX_FIFO_ADDR: address where TX data starts
+    - LORA_RX_FIFO_ADDR: address where RX data starts
 
+In case LORA_RX_FIFO_ADDR is modified, we always read it
+and set LORA_FIFO_ADDR_PTR accordingly.
 ----------------------------------------------------------*/
-if ( *error != RX_NO_ERROR )
+rx_fifo_ptr = loRa_read_register ( LORA_RX_FIFO_ADDR );
+loRa_write_register( LORA_FIFO_ADDR_PTR, rx_fifo_ptr );
+
+return_value_verify = loRa_read_register( LORA_FIFO_ADDR_PTR );
+if( rx_fifo_ptr != return_value_verify )
     {
-    loRa_write_register( LORA_REGISTER_FLAGS, LORA_CLR_RX_ERR_FLAGS );
+    return false;
     }
 
 /*----------------------------------------------------------
-Determine if message has been received
+Set into RX continious mode and verify 
 ----------------------------------------------------------*/
-if ( ( flag_register_data & LORA_RX_DONE_MASK ) == LORA_RX_DONE_MASK )
-    {
-    /*----------------------------------------------------------
-    Verify header
-    ----------------------------------------------------------*/
-    if ( ( flag_register_data & LORA_VALID_HEADER_MASK ) != LORA_VALID_HEADER_MASK )
-        {
-        *error = RX_INVALID_HEADER;
-        }
-    /*----------------------------------------------------------
-    get size
-    ----------------------------------------------------------*/
-    *size = loRa_read_register( LORA_RX_COUNT );
+loRa_write_register(LORA_REGISTER_OP_MODE, LORA_RX_CONT_MODE);
+return_value_verify = loRa_read_register( LORA_REGISTER_OP_MODE );
 
-    /*----------------------------------------------------------
+if( return_value_verify !=  LORA_RX_CONT_MODE )
+    {
+    return false;
+    }
+
+return true;
+
+} /* lora_init_continious_rx() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_send_message
+*
+*   DESCRIPTION:
+*       send message
+*
+*********************************************************************/
+bool lora_send_message
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    )
+{
+/*----------------------------------------------------------
+Load fifo then transmit
+----------------------------------------------------------*/
+if( !lora_load_message( Message, number_of_bytes ) )
+    {
+    return false;
+    }
+
+return lora_transmit();
+
+} /* lora_send_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_load_message
+*
+*   DESCRIPTION:
+*       fills tx fifo and leaves radio in standby, so
+*       lora_transmit() can start the packet at a precise time.
+*       The destination address is put ahead of the message
+*       when addressing is on.
+*
+*********************************************************************/
+bool lora_load_message
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t fifo_ptr_address;       /* fifo pointer address   */
+uint8_t payload_size;           /* address + message size */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+fifo_ptr_address      = 0x00;
+payload_size          = number_of_bytes + s_address_size;
+i                     = 0x00;
+
+/*----------------------------------------------------------
+Verify message and address fit in a packet
+----------------------------------------------------------*/
+if( number_of_bytes > 0xFF - s_address_size )
+    {
+    return false;
+    }
+	
+/*----------------------------------------------------------
+Put into standby mode to fill fifo
+----------------------------------------------------------*/
+loRa_write_register( LORA_REGISTER_OP_MODE, LORA_STBY_MODE);
+
+/*----------------------------------------------------------
+Reset TX fifo 
+----------------------------------------------------------*/
+fifo_ptr_address = loRa_read_register( LORA_TX_FIFO_ADDR );
+
+loRa_write_register( LORA_FIFO_ADDR_PTR, fifo_ptr_address );
+
+if( loRa_read_register( LORA_FIFO_ADDR_PTR ) != fifo_ptr_address )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Every packet starts on the first hop channel
+----------------------------------------------------------*/
+if( s_hop_channels != 0 )
+    {
+    lora_write_frf( s_hop_frf[0] );
+    }
+
+/*----------------------------------------------------------
+Fill in fifo, destination address first (MSB first)
+----------------------------------------------------------*/
+for( i = s_address_size - 1; i >= 0; i-- )
+    {
+    loRa_write_register( LORA_REGISTER_FIFO, (uint8_t)( s_destination >> ( 8 * i ) ) );
+    }
+
+for( i = 0; i < number_of_bytes; i++ )
+    {
+    loRa_write_register( LORA_REGISTER_FIFO, Message[i] );
+    }
+
+/*----------------------------------------------------------
+Set payload length and verify
+----------------------------------------------------------*/
+loRa_write_register( LORA_PAYLOAD_SIZE, payload_size );
+
+if( loRa_read_register( LORA_PAYLOAD_SIZE ) != payload_size )
+    {
+    return false;
+    }
+
+s_loaded_bytes = number_of_bytes;
+
+return true;
+
+} /* lora_load_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_transmit
+*
+*   DESCRIPTION:
+*       sends packet loaded by lora_load_message() and waits
+*       for TxDone. Start and TxDone times are recorded when a
+*       time source is set. Fails without sending when the tx
+*       gate refuses the packet, leaving it loaded. Returns no
+*       sooner than lora_get_mode_delay_us() after the start.
+*
+*********************************************************************/
+bool lora_transmit
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t op_mode;                /* mode after tx write    */
+
+/*----------------------------------------------------------
+Every layer sends through here, let the tx gate charge or
+refuse the packet
+----------------------------------------------------------*/
+if( s_tx_gate != NULL && !s_tx_gate( s_loaded_bytes ) )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Set into TX mode, packet starts on this write
+----------------------------------------------------------*/
+s_dio0_time_valid = false;
+s_tx_start_us     = lora_get_time_us();
+
+loRa_write_register( LORA_REGISTER_OP_MODE, LORA_TX_MODE );
+
+/*----------------------------------------------------------
+Verify TX, or standby with TxDone set as a packet shorter
+than the mode delay is already sent
+----------------------------------------------------------*/
+op_mode = loRa_read_register( LORA_REGISTER_OP_MODE );
+
+if( op_mode != LORA_TX_MODE &&
+    ( op_mode != LORA_STBY_MODE ||
+      ( loRa_read_register( LORA_REGISTER_FLAGS ) & LORA_TX_DONE_MASK ) == 0 ) )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Wait for TX to complete, hops are serviced by the DIO2
+interrupt
+----------------------------------------------------------*/
+while( ( loRa_read_register( LORA_REGISTER_FLAGS ) & LORA_TX_DONE_MASK ) != LORA_TX_DONE_MASK )
+    {
+    }
+s_tx_done_us = lora_take_dio0_time();
+
+/*----------------------------------------------------------
+Clear IRQ flags
+----------------------------------------------------------*/
+loRa_write_register( LORA_REGISTER_FLAGS, LORA_TX_DONE_MASK | LORA_FHSS_CHANGE_MASK );
+
+if( loRa_read_register( LORA_REGISTER_FLAGS ) != 0x00 )
+    {
+    return false;
+    }
+
+return true;
+
+} /* lora_transmit() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_message
+*
+*   DESCRIPTION:
+*       recive message
+*
+*********************************************************************/
+bool lora_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t flag_register_data;      /* data of flag register */
+uint8_t rx_fifo_ptr;             /* rx fifo pointer       */
+uint8_t header[LORA_MAX_ADDRESS_SIZE];
+                                 /* address header bytes  */
+uint8_t header_read;             /* header bytes read     */
+int i;                           /* interator             */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+flag_register_data  = 0x00;
+rx_fifo_ptr         = 0x00;
+header_read         = 0;
+i                   = 0x00;
+
+/*----------------------------------------------------------
+Initilize variables
+----------------------------------------------------------*/
+*error    = RX_NO_ERROR;
+*size           = 0;
+
+/*----------------------------------------------------------
+Determine status of Rx
+----------------------------------------------------------*/
+flag_register_data = loRa_read_register( LORA_REGISTER_FLAGS );
+
+/*----------------------------------------------------------
+Determine if error is present
+----------------------------------------------------------*/
+
+if ( ( flag_register_data & LORA_CRC_ERROR_MASK ) == LORA_CRC_ERROR_MASK )
+    {
+    *error = RX_CRC_ERROR;
+    }
+else if ( ( flag_register_data & LORA_RX_TIMEOUT_MASK ) == LORA_RX_TIMEOUT_MASK )
+    {
+    *error = RX_TIMEOUT;
+    }
+/*----------------------------------------------------------
+If errors are present, clear
+
+-------->>>>>>NEED TO VERIFY single write does not clear all flags
+
+----------------------------------------------------------*/
+if ( *error != RX_NO_ERROR )
+    {
+    loRa_write_register( LORA_REGISTER_FLAGS, LORA_CLR_RX_ERR_FLAGS );
+    }
+
+/*----------------------------------------------------------
+Determine if message has been received
+----------------------------------------------------------*/
+if ( ( flag_register_data & LORA_RX_DONE_MASK ) == LORA_RX_DONE_MASK )
+    {
+    /*----------------------------------------------------------
+    Verify header
+    ----------------------------------------------------------*/
+    if ( ( flag_register_data & LORA_VALID_HEADER_MASK ) != LORA_VALID_HEADER_MASK )
+        {
+        *error = RX_INVALID_HEADER;
+        }
+    s_rx_done_us = lora_take_dio0_time();
+
+    /*----------------------------------------------------------
+    get size
+    ----------------------------------------------------------*/
+    *size = loRa_read_register( LORA_RX_COUNT );
+
+    /*----------------------------------------------------------
     Clear header and rx flag
     ----------------------------------------------------------*/
     loRa_write_register( LORA_REGISTER_FLAGS, LORA_CLR_RX_FLAG );
 
+    /*----------------------------------------------------------
+    Next packet header arrives on the first hop channel
+    ----------------------------------------------------------*/
+    if( s_hop_channels != 0 )
+        {
+        loRa_write_register( LORA_REGISTER_FLAGS, LORA_FHSS_CHANGE_MASK );
+        lora_write_frf( s_hop_frf[0] );
+        }
+
     /*----------------------------------------------------------
     Get fifo pointer and update addresss
     ----------------------------------------------------------*/
@@ -731,18 +1397,47 @@ if ( ( flag_register_data & LORA_RX_DONE_MASK ) == LORA_RX_DONE_MASK )
     loRa_write_register( LORA_FIFO_ADDR_PTR, rx_fifo_ptr );
 
     /*----------------------------------------------------------
-    Verify message[] can fit message received
+    Address filtering. Only the address header is pulled
+    from the fifo, packets for other nodes are dropped
+    before the rest of the payload is read. The header is
+    not returned.
     ----------------------------------------------------------*/
-    if( *size > size_of_message )
+    if( s_address_size != 0 )
         {
-        *error = RX_ARRAY_SIZE_ERR;
-        *size = 0;
-        }
-    else
-        {
-        /*----------------------------------------------------------
-        Tranfer message to array
-        ----------------------------------------------------------*/
+        if( *size < s_address_size )
+            {
+            s_filter_stats.dropped++;
+            *size = 0;
+            return false;
+            }
+
+        for( header_read = 0; header_read < s_address_size; header_read++ )
+            {
+            header[header_read] = loRa_read_register( LORA_REGISTER_FIFO );
+            }
+        *size -= s_address_size;
+
+        if( *error == RX_NO_ERROR && !lora_match_address( header ) )
+            {
+            s_filter_stats.dropped++;
+            *size = 0;
+            return false;
+            }
+        }
+
+    /*----------------------------------------------------------
+    Verify message[] can fit message received
+    ----------------------------------------------------------*/
+    if( *size > size_of_message )
+        {
+        *error = RX_ARRAY_SIZE_ERR;
+        *size = 0;
+        }
+    else
+        {
+        /*----------------------------------------------------------
+        Tranfer message to array
+        ----------------------------------------------------------*/
         for( i = 0; i < *size; i++ )
             {
             message[i] = loRa_read_register( LORA_REGISTER_FIFO );
@@ -762,3 +1457,1012 @@ else
     return false;
     }
 } /* lora_get_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_address_size
+*
+*   DESCRIPTION:
+*       sets size of the address header. When non zero every
+*       packet sent starts with the address from
+*       lora_set_destination(), and received packets are
+*       filtered on it and returned without it, so the layers
+*       above only ever see their own payload. 0 disables
+*       addressing and every packet is returned by
+*       lora_get_message(). All nodes must use the same size.
+*
+*********************************************************************/
+bool lora_set_address_size
+    (
+    uint8_t address_size                  /* address header bytes,
+                                             0 disables filtering   */
+    )
+{
+if( address_size > LORA_MAX_ADDRESS_SIZE )
+    {
+    return false;
+    }
+
+s_address_size = address_size;
+
+return true;
+
+} /* lora_set_address_size() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_destination
+*
+*   DESCRIPTION:
+*       sets address put ahead of packets sent while addressing
+*       is on. Defaults to LORA_BROADCAST_ADDRESS.
+*
+*********************************************************************/
+void lora_set_destination
+    (
+    uint16_t address                      /* destination address    */
+    )
+{
+s_destination = address;
+
+} /* lora_set_destination() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_address_filter
+*
+*   DESCRIPTION:
+*       accepts packets whose address matches address in the
+*       bits set in mask. Use a full mask for a node address,
+*       a partial mask for a group, or broadcast as its own
+*       filter. Only the low address size bytes of address and
+*       mask are compared.
+*
+*********************************************************************/
+bool lora_set_address_filter
+    (
+    uint8_t  filter,                      /* filter index           */
+    uint16_t address,                     /* address to accept      */
+    uint16_t mask                         /* address bits compared  */
+    )
+{
+if( filter >= LORA_MAX_ADDRESS_FILTERS )
+    {
+    return false;
+    }
+
+s_address_filters[filter].address = address;
+s_address_filters[filter].mask    = mask;
+s_address_filters[filter].enabled = true;
+s_filter_stats.hits[filter]       = 0;
+
+return true;
+
+} /* lora_set_address_filter() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_clear_address_filter
+*
+*   DESCRIPTION:
+*       disables a filter
+*
+*********************************************************************/
+bool lora_clear_address_filter
+    (
+    uint8_t  filter                       /* filter index           */
+    )
+{
+if( filter >= LORA_MAX_ADDRESS_FILTERS )
+    {
+    return false;
+    }
+
+s_address_filters[filter].enabled = false;
+
+return true;
+
+} /* lora_clear_address_filter() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_filter_stats
+*
+*   DESCRIPTION:
+*       returns per filter hit counts and dropped packet count
+*
+*********************************************************************/
+void lora_get_filter_stats
+    (
+    lora_filter_stats *stats,             /* returned counters      */
+    bool               reset              /* zero counters T/F      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int i;                          /* interator              */
+
+*stats = s_filter_stats;
+
+if( reset )
+    {
+    for( i = 0; i < LORA_MAX_ADDRESS_FILTERS; i++ )
+        {
+        s_filter_stats.hits[i] = 0;
+        }
+    s_filter_stats.dropped = 0;
+    }
+
+} /* lora_get_filter_stats() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_frequency
+*
+*   DESCRIPTION:
+*       sets carrier frequency. Leaves the radio in standby mode,
+*       re-init rx after calling if receiving. Ignored while a
+*       hop table is set.
+*
+*********************************************************************/
+bool lora_set_frequency
+    (
+    uint32_t frequency_hz                 /* carrier frequency (Hz) */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t frf;                 /* Frf register value       */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+frf = (uint32_t)( ( (uint64_t)frequency_hz << LORA_FRF_SHIFT ) / LORA_XOSC_HZ );
+
+/*----------------------------------------------------------
+Verify port selection has been made and not hopping
+----------------------------------------------------------*/
+if ( !s_port_inited || s_hop_channels != 0 )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Frequency can only be changed in sleep or standby
+----------------------------------------------------------*/
+loRa_write_register( LORA_REGISTER_OP_MODE, LORA_STBY_MODE );
+lora_write_frf( frf );
+
+if( loRa_read_register( LORA_FRF_MSB ) != (uint8_t)( frf >> 16 ) ||
+    loRa_read_register( LORA_FRF_MID ) != (uint8_t)( frf >> 8 )  ||
+    loRa_read_register( LORA_FRF_LSB ) != (uint8_t)( frf )       )
+    {
+    return false;
+    }
+
+return true;
+
+} /* lora_set_frequency() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_frequency
+*
+*   DESCRIPTION:
+*       returns carrier frequency in Hz, the first hop channel
+*       while hopping
+*
+*********************************************************************/
+uint32_t lora_get_frequency
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t frf;                 /* Frf register value       */
+
+frf = ( s_hop_channels != 0 ) ? s_hop_frf[0] : s_frf;
+
+return (uint32_t)( ( (uint64_t)frf * LORA_XOSC_HZ ) >> LORA_FRF_SHIFT );
+
+} /* lora_get_frequency() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_hop_frequency
+*
+*   DESCRIPTION:
+*       returns frequency in Hz of a hop channel, false past
+*       the end of the hop table or when not hopping
+*
+*********************************************************************/
+bool lora_get_hop_frequency
+    (
+    uint8_t   channel,                    /* hop table index        */
+    uint32_t *frequency_hz                /* returned frequency (Hz)*/
+    )
+{
+if( channel >= s_hop_channels )
+    {
+    return false;
+    }
+
+*frequency_hz = (uint32_t)( ( (uint64_t)s_hop_frf[channel] * LORA_XOSC_HZ ) >> LORA_FRF_SHIFT );
+
+return true;
+
+} /* lora_get_hop_frequency() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_hop_table
+*
+*   DESCRIPTION:
+*       configures frequency hopping. Each packet starts on
+*       frequencies_hz[0] and moves to the next table entry
+*       every hop_period symbols. Frequencies are converted to
+*       register values here so the hop itself is only three
+*       register writes. Written to the radio immediately if the
+*       port is inited, so call between packets. Hops must be
+*       serviced from the DIO2 interrupt, as register writes
+*       that change mode block for LORA_MODE_DELAY_LOOPS, so
+*       lora_fhss_interrupt_init() must be done first.
+*
+*********************************************************************/
+bool lora_set_hop_table
+    (
+    uint32_t frequencies_hz[],            /* hop channels (Hz)      */
+    uint8_t  number_of_channels,          /* size of array, 0 stops
+                                             hopping                */
+    uint8_t  hop_period                   /* symbols per hop        */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t hop_time_us;         /* duration of one hop      */
+int i;                        /* interator                */
+
+/*----------------------------------------------------------
+Zero channels turns hopping off
+----------------------------------------------------------*/
+if( number_of_channels == 0 )
+    {
+    s_hop_channels = 0;
+    s_hop_period   = 0;
+    return !s_port_inited || lora_write_hop_config();
+    }
+
+/*----------------------------------------------------------
+Verify the hop interrupt is set up, the table fits and each
+hop leaves time to retune at the current modem settings
+----------------------------------------------------------*/
+hop_time_us = hop_period * ( ( 1000000UL << s_spreading_factor ) / s_bandwidth_hz[s_bandwidth] );
+
+if( s_dio2_base == 0                           ||
+    number_of_channels > LORA_MAX_HOP_CHANNELS ||
+    hop_time_us < LORA_MIN_HOP_TIME_US         )
+    {
+    return false;
+    }
+
+for( i = 0; i < number_of_channels; i++ )
+    {
+    s_hop_frf[i] = (uint32_t)( ( (uint64_t)frequencies_hz[i] << LORA_FRF_SHIFT ) / LORA_XOSC_HZ );
+    }
+
+s_hop_channels = number_of_channels;
+s_hop_period   = hop_period;
+
+/*----------------------------------------------------------
+Write now so tx and rx agree on hopping
+----------------------------------------------------------*/
+if( !s_port_inited )
+    {
+    return true;
+    }
+
+return lora_write_hop_config();
+
+} /* lora_set_hop_table() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_service_fhss
+*
+*   DESCRIPTION:
+*       moves to the next hop channel when FhssChangeChannel is
+*       set. Called by lora_dio2_isr(). Runs with interrupts
+*       held off so a foreground call and the interrupt cannot
+*       interleave. Returns true if a hop was serviced.
+*
+*********************************************************************/
+bool lora_service_fhss
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t channel;              /* present hop channel      */
+bool    int_disabled;         /* interrupts already off   */
+bool    serviced;             /* hop serviced T/F         */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+serviced     = false;
+int_disabled = IntMasterDisable();
+
+if( s_hop_channels != 0 &&
+    ( loRa_read_register( LORA_REGISTER_FLAGS ) & LORA_FHSS_CHANGE_MASK ) != 0 )
+    {
+    /*----------------------------------------------------------
+    Radio has advanced the channel counter, tune to it
+    ----------------------------------------------------------*/
+    channel = loRa_read_register( LORA_HOP_CHANNEL ) & LORA_HOP_CHANNEL_MASK;
+    lora_write_frf( s_hop_frf[channel % s_hop_channels] );
+
+    loRa_write_register( LORA_REGISTER_FLAGS, LORA_FHSS_CHANGE_MASK );
+    serviced = true;
+    }
+
+if( !int_disabled )
+    {
+    IntMasterEnable();
+    }
+
+return serviced;
+
+} /* lora_service_fhss() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_fhss_interrupt_init
+*
+*   DESCRIPTION:
+*       maps FhssChangeChannel to DIO2 and sets up a rising edge
+*       interrupt on the pin DIO2 is wired to. Call
+*       lora_dio2_isr() from that port's GPIO interrupt handler
+*       so hops are serviced in tx and rx.
+*
+*********************************************************************/
+bool lora_fhss_interrupt_init
+    (
+    CS_port dio2_port,                    /* port DIO2 is wired to  */
+    uint8_t dio2_pin                      /* pin DIO2 is wired to   */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t register_data;        /* register data            */
+
+/*----------------------------------------------------------
+Verify port selection has been made and DIO2 port exists
+----------------------------------------------------------*/
+if ( !s_port_inited || dio2_port > PORT_F )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Map FhssChangeChannel to DIO2 and verify
+----------------------------------------------------------*/
+register_data = loRa_read_register( LORA_DIO_MAPPING_1 ) & ~LORA_DIO2_MAPPING_MASK;
+loRa_write_register( LORA_DIO_MAPPING_1, register_data );
+
+if( loRa_read_register( LORA_DIO_MAPPING_1 ) != register_data )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Rising edge interrupt on DIO2 pin
+----------------------------------------------------------*/
+s_dio2_base = s_gpio_base[dio2_port];
+s_dio2_pin  = dio2_pin;
+
+SysCtlPeripheralEnable( s_gpio_periph[dio2_port] );
+while( !SysCtlPeripheralReady( s_gpio_periph[dio2_port] ) )
+    {
+    }
+
+GPIOPinTypeGPIOInput( s_dio2_base, s_dio2_pin );
+GPIOIntTypeSet( s_dio2_base, s_dio2_pin, GPIO_RISING_EDGE );
+GPIOIntClear( s_dio2_base, s_dio2_pin );
+GPIOIntEnable( s_dio2_base, s_dio2_pin );
+IntEnable( s_gpio_int[dio2_port] );
+
+return true;
+
+} /* lora_fhss_interrupt_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_dio2_isr
+*
+*   DESCRIPTION:
+*       call from the GPIO interrupt handler of the DIO2 port.
+*       Clears the pin interrupt and services the hop.
+*
+*********************************************************************/
+void lora_dio2_isr
+    (
+    void
+    )
+{
+GPIOIntClear( s_dio2_base, s_dio2_pin );
+lora_service_fhss();
+
+} /* lora_dio2_isr() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_modem_config
+*
+*   DESCRIPTION:
+*       sets spreading factor and bandwidth. Nothing is written
+*       if the settings are unchanged. The radio is put in
+*       standby for the change and returned to rx continious
+*       mode if it was receiving. Coding rate, header mode and
+*       CRC bits are left untouched. Fails while hopping if the
+*       new settings make a hop shorter than
+*       LORA_MIN_HOP_TIME_US.
+*
+*********************************************************************/
+bool lora_set_modem_config
+    (
+    lora_spreading_factor spreading_factor, /* spreading factor     */
+    lora_bandwidth        bandwidth         /* signal bandwidth     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t  modem_config;         /* modem config register data */
+uint32_t symbol_time_us;       /* duration of one symbol     */
+uint8_t  op_mode;              /* mode before the change     */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+modem_config   = 0x00;
+symbol_time_us = 0;
+op_mode        = 0x00;
+
+/*----------------------------------------------------------
+Verify port selection has been made and settings are
+in range
+----------------------------------------------------------*/
+if ( !s_port_inited                      ||
+     spreading_factor < LORA_SF_7        ||
+     spreading_factor > LORA_SF_12       ||
+     bandwidth        > LORA_BW_500_KHZ  )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Verify a hop still leaves time to retune
+----------------------------------------------------------*/
+symbol_time_us = ( ( 1000000UL << spreading_factor ) / s_bandwidth_hz[bandwidth] );
+
+if( s_hop_channels != 0 &&
+    s_hop_period * symbol_time_us < LORA_MIN_HOP_TIME_US )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Skip the mode change and register writes if unchanged
+----------------------------------------------------------*/
+if( s_modem_configured                    &&
+    spreading_factor == s_spreading_factor &&
+    bandwidth        == s_bandwidth        )
+    {
+    return true;
+    }
+
+/*----------------------------------------------------------
+Modem config can only be changed in sleep or standby
+----------------------------------------------------------*/
+op_mode = loRa_read_register( LORA_REGISTER_OP_MODE );
+loRa_write_register( LORA_REGISTER_OP_MODE, LORA_STBY_MODE );
+
+/*----------------------------------------------------------
+Configure bandwidth (bits 7-4) and verify
+----------------------------------------------------------*/
+modem_config = loRa_read_register( LORA_MODEM_CONFIG_1 );
+modem_config = ( modem_config & LORA_LOWER_NIBBLE_MASK ) |
+               ( bandwidth << LORA_UPPER_NIBBLE_SHIFT );
+loRa_write_register( LORA_MODEM_CONFIG_1, modem_config );
+
+if( loRa_read_register( LORA_MODEM_CONFIG_1 ) != modem_config )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Configure spreading factor (bits 7-4) and verify
+----------------------------------------------------------*/
+modem_config = loRa_read_register( LORA_MODEM_CONFIG_2 );
+modem_config = ( modem_config & LORA_LOWER_NIBBLE_MASK ) |
+               ( spreading_factor << LORA_UPPER_NIBBLE_SHIFT );
+loRa_write_register( LORA_MODEM_CONFIG_2, modem_config );
+
+if( loRa_read_register( LORA_MODEM_CONFIG_2 ) != modem_config )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Low data rate optimize is mandated when a symbol lasts
+longer than 16ms
+----------------------------------------------------------*/
+modem_config = loRa_read_register( LORA_MODEM_CONFIG_3 );
+if( symbol_time_us > LORA_LOW_DR_SYMBOL_US )
+    {
+    modem_config |= LORA_LOW_DR_OPT_MASK;
+    }
+else
+    {
+    modem_config &= ~LORA_LOW_DR_OPT_MASK;
+    }
+loRa_write_register( LORA_MODEM_CONFIG_3, modem_config );
+
+if( loRa_read_register( LORA_MODEM_CONFIG_3 ) != modem_config )
+    {
+    return false;
+    }
+
+s_spreading_factor = spreading_factor;
+s_bandwidth        = bandwidth;
+s_modem_configured = true;
+
+/*----------------------------------------------------------
+Resume receiving and verify
+----------------------------------------------------------*/
+if( op_mode == LORA_RX_CONT_MODE )
+    {
+    loRa_write_register( LORA_REGISTER_OP_MODE, LORA_RX_CONT_MODE );
+
+    if( loRa_read_register( LORA_REGISTER_OP_MODE ) != LORA_RX_CONT_MODE )
+        {
+        return false;
+        }
+    }
+
+return true;
+
+} /* lora_set_modem_config() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_power_config
+*
+*   DESCRIPTION:
+*       sets PA select, output power, OCP, PaDac and PA ramp.
+*       Written immediately if the port is inited, otherwise on
+*       the next lora_init_tx(). Call between packets, not
+*       during tx. High power mode draws more than the default
+*       100mA, so it is rejected unless OCP is disabled or trips
+*       at LORA_HIGH_POWER_OCP_MA or above.
+*
+*********************************************************************/
+bool lora_set_power_config
+    (
+    lora_power_config config              /* tx power settings      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t pa_config;            /* RegPaConfig data         */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+pa_config = 0x00;
+
+/*----------------------------------------------------------
+Verify settings are in range
+----------------------------------------------------------*/
+if( !lora_pa_config_value( config, &pa_config ) ||
+    config.pa_ramp > LORA_PA_RAMP_10_US         ||
+    ( config.ocp_ma != 0 &&
+      ( config.ocp_ma < LORA_OCP_MIN_MA || config.ocp_ma > LORA_OCP_MAX_MA ) ) ||
+    ( config.high_power && config.ocp_ma != 0 &&
+      config.ocp_ma < LORA_HIGH_POWER_OCP_MA ) )
+    {
+    return false;
+    }
+
+s_power_config = config;
+
+/*----------------------------------------------------------
+Write to radio if port selection has been made
+----------------------------------------------------------*/
+if( !s_port_inited )
+    {
+    return true;
+    }
+
+return lora_write_power_config();
+
+} /* lora_set_power_config() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_tx_power
+*
+*   DESCRIPTION:
+*       changes output power only, keeping the rest of the power
+*       config. Only RegPaConfig is written so this can be
+*       called before each packet without re-initilizing tx
+*
+*********************************************************************/
+bool lora_set_tx_power
+    (
+    int8_t power_dbm                      /* output power in dBm    */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+lora_power_config config;     /* updated power config     */
+uint8_t           pa_config;  /* RegPaConfig data         */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+config           = s_power_config;
+config.power_dbm = power_dbm;
+pa_config        = 0x00;
+
+/*----------------------------------------------------------
+Verify port selection has been made and power in range
+for the selected PA
+----------------------------------------------------------*/
+if ( !s_port_inited || !lora_pa_config_value( config, &pa_config ) )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Configure power and verify
+----------------------------------------------------------*/
+loRa_write_register( LORA_REGISTER_POWER, pa_config );
+
+if( loRa_read_register( LORA_REGISTER_POWER ) != pa_config )
+    {
+    return false;
+    }
+
+s_power_config = config;
+
+return true;
+
+} /* lora_set_tx_power() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_packet_snr
+*
+*   DESCRIPTION:
+*       returns SNR of last received packet in 0.25 dB steps
+*
+*********************************************************************/
+bool lora_get_packet_snr
+    (
+    int8_t *snr                        /* SNR of last packet in
+                                          0.25 dB steps             */
+    )
+{
+/*----------------------------------------------------------
+Verify port selection has been made
+----------------------------------------------------------*/
+if ( !s_port_inited )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Register holds SNR as two's complement quarter dB
+----------------------------------------------------------*/
+*snr = (int8_t)loRa_read_register( LORA_PKT_SNR_VALUE );
+
+return true;
+
+} /* lora_get_packet_snr() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_time_on_air_us
+*
+*   DESCRIPTION:
+*       returns time on air of a packet at the current spreading
+*       factor and bandwidth. Assumes reset values for the rest
+*       of the modem (8 symbol preamble, explicit header, CR 4/5)
+*       and counts the payload CRC and the address header so the
+*       result is an upper bound.
+*
+*********************************************************************/
+uint32_t lora_get_time_on_air_us
+    (
+    uint8_t number_of_bytes               /* payload size           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t symbol_time_us;       /* duration of one symbol     */
+int32_t  payload_bits;         /* bits after the header      */
+int32_t  bits_per_block;       /* bits per coded block       */
+uint32_t payload_symbols;      /* payload symbol count       */
+uint64_t quarter_symbols;      /* packet length in 1/4 sym   */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+symbol_time_us  = ( ( 1000000UL << s_spreading_factor ) / s_bandwidth_hz[s_bandwidth] );
+payload_bits    = ( 8 * ( number_of_bytes + s_address_size ) ) - ( 4 * s_spreading_factor ) + 28 + LORA_CRC_BITS;
+bits_per_block  = 4 * s_spreading_factor;
+payload_symbols = 8;
+
+/*----------------------------------------------------------
+Low data rate optimize drops two bits per symbol
+----------------------------------------------------------*/
+if( symbol_time_us > LORA_LOW_DR_SYMBOL_US )
+    {
+    bits_per_block -= 8;
+    }
+
+/*----------------------------------------------------------
+Payload symbols (SX127x datasheet 4.1.1.7)
+----------------------------------------------------------*/
+if( payload_bits > 0 )
+    {
+    payload_symbols += ( ( payload_bits + bits_per_block - 1 ) / bits_per_block ) *
+                       ( LORA_CODING_RATE + 4 );
+    }
+
+quarter_symbols = LORA_PREAMBLE_QSYMBOLS + ( 4 * payload_symbols );
+
+return (uint32_t)( ( quarter_symbols * ( 1000000ULL << s_spreading_factor ) ) /
+                   ( 4ULL * s_bandwidth_hz[s_bandwidth] ) );
+
+} /* lora_get_time_on_air_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_mode_delay_us
+*
+*   DESCRIPTION:
+*       returns time every OP_MODE write blocks for while the
+*       radio settles in the new mode
+*
+*********************************************************************/
+uint32_t lora_get_mode_delay_us
+    (
+    void
+    )
+{
+return (uint32_t)( ( (uint64_t)LORA_MODE_DELAY_LOOPS * SYSCTL_DELAY_CYCLES * 1000000ULL ) /
+                   SysCtlClockGet() );
+
+} /* lora_get_mode_delay_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_rx_turnaround_us
+*
+*   DESCRIPTION:
+*       returns time lora_init_continious_rx() takes, set by the
+*       settle delay after each of its OP_MODE writes. This is
+*       the least time from TxDone until the radio can receive.
+*
+*********************************************************************/
+uint32_t lora_get_rx_turnaround_us
+    (
+    void
+    )
+{
+return LORA_RX_INIT_MODE_WRITES * lora_get_mode_delay_us();
+
+} /* lora_get_rx_turnaround_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_send_time_us
+*
+*   DESCRIPTION:
+*       returns time lora_send_message() and the following
+*       lora_init_continious_rx() take for a packet: the standby
+*       write of the fifo load, the tx write or the time on air
+*       if longer, then the rx turnaround
+*
+*********************************************************************/
+uint32_t lora_get_send_time_us
+    (
+    uint8_t number_of_bytes               /* payload size           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t air_us;                /* packet time on air     */
+uint32_t mode_us;               /* one mode delay         */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+air_us  = lora_get_time_on_air_us( number_of_bytes );
+mode_us = lora_get_mode_delay_us();
+
+return mode_us + ( ( air_us > mode_us ) ? air_us : mode_us ) + lora_get_rx_turnaround_us();
+
+} /* lora_get_send_time_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_time_source
+*
+*   DESCRIPTION:
+*       sets function returning a free running microsecond count
+*       used to timestamp TxDone / RxDone
+*
+*********************************************************************/
+void lora_set_time_source
+    (
+    uint32_t (*time_source)( void )       /* microsecond timer read */
+    )
+{
+s_time_source = time_source;
+
+} /* lora_set_time_source() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_set_tx_gate
+*
+*   DESCRIPTION:
+*       sets function called by lora_transmit() with the message
+*       size of every packet before it is sent. Returning false
+*       holds the packet back. NULL removes the gate.
+*
+*********************************************************************/
+void lora_set_tx_gate
+    (
+    bool (*tx_gate)( uint8_t number_of_bytes ) /* tx check          */
+    )
+{
+s_tx_gate = tx_gate;
+
+} /* lora_set_tx_gate() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_time_us
+*
+*   DESCRIPTION:
+*       returns time source reading, 0 when none is set
+*
+*********************************************************************/
+uint32_t lora_get_time_us
+    (
+    void
+    )
+{
+if( s_time_source == NULL )
+    {
+    return 0;
+    }
+
+return s_time_source();
+
+} /* lora_get_time_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_dio0_isr
+*
+*   DESCRIPTION:
+*       call from the DIO0 interrupt handler. DIO0 signals
+*       TxDone in tx and RxDone in rx, so the edge time is
+*       captured here and used as the timestamp instead of the
+*       time the flag was polled.
+*
+*********************************************************************/
+void lora_dio0_isr
+    (
+    void
+    )
+{
+s_dio0_time_us    = lora_get_time_us();
+s_dio0_time_valid = true;
+
+} /* lora_dio0_isr() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_tx_start_time
+*
+*   DESCRIPTION:
+*       returns time the last packet was started
+*
+*********************************************************************/
+uint32_t lora_get_tx_start_time
+    (
+    void
+    )
+{
+return s_tx_start_us;
+
+} /* lora_get_tx_start_time() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_tx_done_time
+*
+*   DESCRIPTION:
+*       returns TxDone time of the last packet sent
+*
+*********************************************************************/
+uint32_t lora_get_tx_done_time
+    (
+    void
+    )
+{
+return s_tx_done_us;
+
+} /* lora_get_tx_done_time() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_get_rx_done_time
+*
+*   DESCRIPTION:
+*       returns RxDone time of the last packet received
+*
+*********************************************************************/
+uint32_t lora_get_rx_done_time
+    (
+    void
+    )
+{
+return s_rx_done_us;
+
+} /* lora_get_rx_done_time() */
@@ -7,6 +7,9 @@
 *
 *********************************************************************/
 
+#ifndef LORA_API_H
+#define LORA_API_H
+
 /*--------------------------------------------------------------------
                            GENERAL INCLUDES
 --------------------------------------------------------------------*/
@@ -19,6 +22,15 @@
 --------------------------------------------------------------------*/
 #define MAX_LORA_MSG_SIZE ( 16 )   /* Buffer size on lora tranciver */
 
+#define LORA_MAX_ADDRESS_FILTERS ( 4 ) /* node / group address filters */
+
+#define LORA_MAX_ADDRESS_SIZE   ( 2 )  /* max address header bytes     */
+
+#define LORA_BROADCAST_ADDRESS  ( 0xFFFF ) /* default destination, low
+                                              byte with 1 byte headers  */
+
+#define LORA_MAX_HOP_CHANNELS   ( 64 ) /* FHSS hop table size          */
+
 /*--------------------------------------------------------------------
                                 TYPES
 --------------------------------------------------------------------*/
@@ -60,6 +72,81 @@ typedef struct
     uint8_t  SSI_PIN;                     /* PI port selected       */             
     } lora_config;                        /* SPI interface info     */
 
+typedef uint8_t lora_spreading_factor; /* Spreading factor          */
+enum
+    {
+    LORA_SF_7 = 7,                    /* 128 chips / symbol         */
+    LORA_SF_8,                        /* 256 chips / symbol         */
+    LORA_SF_9,                        /* 512 chips / symbol         */
+    LORA_SF_10,                       /* 1024 chips / symbol        */
+    LORA_SF_11,                       /* 2048 chips / symbol        */
+    LORA_SF_12                        /* 4096 chips / symbol        */
+    };
+
+typedef uint8_t lora_bandwidth;        /* Signal bandwidth          */
+enum
+    {
+    LORA_BW_7_8_KHZ,                  /* 7.8 kHz                    */
+    LORA_BW_10_4_KHZ,                 /* 10.4 kHz                   */
+    LORA_BW_15_6_KHZ,                 /* 15.6 kHz                   */
+    LORA_BW_20_8_KHZ,                 /* 20.8 kHz                   */
+    LORA_BW_31_25_KHZ,                /* 31.25 kHz                  */
+    LORA_BW_41_7_KHZ,                 /* 41.7 kHz                   */
+    LORA_BW_62_5_KHZ,                 /* 62.5 kHz                   */
+    LORA_BW_125_KHZ,                  /* 125 kHz                    */
+    LORA_BW_250_KHZ,                  /* 250 kHz                    */
+    LORA_BW_500_KHZ                   /* 500 kHz                    */
+    };
+
+typedef uint8_t lora_pa_select;        /* Power amplifier output    */
+enum
+    {
+    LORA_PA_RFO,                      /* RFO pin, 0 to 15 dBm       */
+    LORA_PA_BOOST                     /* PA_BOOST pin, 2 to 17 dBm,
+                                         5 to 20 dBm in high power  */
+    };
+
+typedef uint8_t lora_pa_ramp;          /* PA rise / fall time       */
+enum
+    {
+    LORA_PA_RAMP_3400_US,             /* 3.4 ms                     */
+    LORA_PA_RAMP_2000_US,             /* 2 ms                       */
+    LORA_PA_RAMP_1000_US,             /* 1 ms                       */
+    LORA_PA_RAMP_500_US,              /* 500 us                     */
+    LORA_PA_RAMP_250_US,              /* 250 us                     */
+    LORA_PA_RAMP_125_US,              /* 125 us                     */
+    LORA_PA_RAMP_100_US,              /* 100 us                     */
+    LORA_PA_RAMP_62_US,               /* 62 us                      */
+    LORA_PA_RAMP_50_US,               /* 50 us                      */
+    LORA_PA_RAMP_40_US,               /* 40 us                      */
+    LORA_PA_RAMP_31_US,               /* 31 us                      */
+    LORA_PA_RAMP_25_US,               /* 25 us                      */
+    LORA_PA_RAMP_20_US,               /* 20 us                      */
+    LORA_PA_RAMP_15_US,               /* 15 us                      */
+    LORA_PA_RAMP_12_US,               /* 12 us                      */
+    LORA_PA_RAMP_10_US                /* 10 us                      */
+    };
+
+typedef struct
+    {
+    lora_pa_select pa_select;             /* PA output pin          */
+    int8_t         power_dbm;             /* output power in dBm    */
+    bool           high_power;            /* PaDac +20 dBm mode,
+                                             PA_BOOST only          */
+    uint8_t        ocp_ma;                /* over current trip in mA
+                                             45 to 240, 0 disables,
+                                             140+ for high_power    */
+    lora_pa_ramp   pa_ramp;               /* PA ramp time           */
+    } lora_power_config;                  /* tx power settings      */
+
+typedef struct
+    {
+    uint32_t hits[LORA_MAX_ADDRESS_FILTERS]; /* packets passed per
+                                                filter              */
+    uint32_t dropped;                        /* packets matching no
+                                                filter              */
+    } lora_filter_stats;                     /* address filter stats */
+
 /*--------------------------------------------------------------------
                            MEMORY CONSTANTS
 --------------------------------------------------------------------*/
@@ -99,6 +186,17 @@ bool lora_send_message
     uint8_t number_of_bytes               /* size of array          */
     );
 
+bool lora_load_message
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    );
+
+bool lora_transmit
+    (
+    void
+    );
+
 bool lora_get_message
     (
     uint8_t *message,                  /* pointer to return message */
@@ -107,4 +205,152 @@ bool lora_get_message
     lora_errors *error                 /* pointer to error variable */
     );
 
+bool lora_set_address_size
+    (
+    uint8_t address_size                  /* address header bytes,
+                                             0 disables filtering   */
+    );
+
+void lora_set_destination
+    (
+    uint16_t address                      /* destination address    */
+    );
+
+bool lora_set_address_filter
+    (
+    uint8_t  filter,                      /* filter index           */
+    uint16_t address,                     /* address to accept      */
+    uint16_t mask                         /* address bits compared  */
+    );
+
+bool lora_clear_address_filter
+    (
+    uint8_t  filter                       /* filter index           */
+    );
+
+void lora_get_filter_stats
+    (
+    lora_filter_stats *stats,             /* returned counters      */
+    bool               reset              /* zero counters T/F      */
+    );
+
+bool lora_set_frequency
+    (
+    uint32_t frequency_hz                 /* carrier frequency (Hz) */
+    );
+
+uint32_t lora_get_frequency
+    (
+    void
+    );
+
+bool lora_get_hop_frequency
+    (
+    uint8_t   channel,                    /* hop table index        */
+    uint32_t *frequency_hz                /* returned frequency (Hz)*/
+    );
+
+bool lora_set_hop_table
+    (
+    uint32_t frequencies_hz[],            /* hop channels (Hz)      */
+    uint8_t  number_of_channels,          /* size of array, 0 stops
+                                             hopping                */
+    uint8_t  hop_period                   /* symbols per hop        */
+    );
+
+bool lora_service_fhss
+    (
+    void
+    );
+
+bool lora_fhss_interrupt_init
+    (
+    CS_port dio2_port,                    /* port DIO2 is wired to  */
+    uint8_t dio2_pin                      /* pin DIO2 is wired to   */
+    );
+
+void lora_dio2_isr
+    (
+    void
+    );
+
+bool lora_set_modem_config
+    (
+    lora_spreading_factor spreading_factor, /* spreading factor     */
+    lora_bandwidth        bandwidth         /* signal bandwidth     */
+    );
+
+bool lora_set_power_config
+    (
+    lora_power_config config              /* tx power settings      */
+    );
+
+bool lora_set_tx_power
+    (
+    int8_t power_dbm                      /* output power in dBm    */
+    );
+
+uint32_t lora_get_time_on_air_us
+    (
+    uint8_t number_of_bytes               /* payload size           */
+    );
+
+uint32_t lora_get_mode_delay_us
+    (
+    void
+    );
+
+uint32_t lora_get_rx_turnaround_us
+    (
+    void
+    );
+
+uint32_t lora_get_send_time_us
+    (
+    uint8_t number_of_bytes               /* payload size           */
+    );
+
+bool lora_get_packet_snr
+    (
+    int8_t *snr                        /* SNR of last packet in
+                                          0.25 dB steps             */
+    );
+
+void lora_set_time_source
+    (
+    uint32_t (*time_source)( void )       /* microsecond timer read */
+    );
+
+void lora_set_tx_gate
+    (
+    bool (*tx_gate)( uint8_t number_of_bytes ) /* tx check          */
+    );
+
+uint32_t lora_get_time_us
+    (
+    void
+    );
+
+void lora_dio0_isr
+    (
+    void
+    );
+
+uint32_t lora_get_tx_start_time
+    (
+    void
+    );
+
+uint32_t lora_get_tx_done_time
+    (
+    void
+    );
+
+uint32_t lora_get_rx_done_time
+    (
+    void
+    );
+
+#endif /* LORA_API_H */
+
 /* LoraAPI.h */
@@ -0,0 +1,814 @@
+/*********************************************************************
+*
+*   NAME:
+*       loraARQ.c
+*
+*   DESCRIPTION:
+*       Optional reliable transport on top of the LoRa API using
+*       selective repeat ARQ between two nodes. Up to
+*       LORA_ARQ_WINDOW_SIZE frames are kept in flight, every frame
+*       carries the receive window base and a bitmap of frames
+*       held beyond it, and only frames missing from the bitmap
+*       are retransmitted. Timeouts start from the driver send
+*       time and adapt to measured round trip times. An ack gives
+*       no sample if anything was retransmitted after the frame
+*       was sent, as a retransmission may have provoked it
+*       (Karn), and the timeout drops back from backoff as soon
+*       as an ack covers new data.
+*
+*       Frame layout:
+*           byte 0  - frame type (data / ack)
+*           byte 1  - sequence number (data only)
+*           byte 2  - receive window base, all earlier frames
+*                     have been delivered
+*           byte 3  - bitmap, bit n set if frame base + n is held
+*           byte 4+ - payload (data only)
+*
+*       The receive window only slides as the application calls
+*       lora_arq_get_message(), which gives flow control: new
+*       frames are only sent within LORA_ARQ_WINDOW_SIZE of the
+*       base the peer last advertised. While that window is
+*       closed the sender probes for an ack every timeout so a
+*       lost window update cannot stall the link. Probes and
+*       duplicate data are acked at once.
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+#include "LoraARQ.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define ARQ_HEADER_SIZE         ( 4 )      /* type, seq, base, bitmap   */
+
+#define ARQ_FRAME_SIZE          ( ARQ_HEADER_SIZE + LORA_ARQ_MAX_PAYLOAD )
+                                           /* largest frame on air      */
+
+#define ARQ_MAX_RTO_MS          ( 60000 )  /* retransmit timeout cap    */
+
+#define US_PER_MS               ( 1000 )   /* microseconds per ms       */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef uint8_t arq_frame_type;   /* ARQ frame types                */
+enum
+    {
+    ARQ_FRAME_DATA = 0xA0,        /* data frame with piggyback ack  */
+    ARQ_FRAME_ACK  = 0xA1,        /* standalone ack frame           */
+    ARQ_FRAME_PROBE = 0xA2        /* window probe, asks for an ack  */
+    };
+
+typedef struct
+    {
+    uint8_t  data[LORA_ARQ_MAX_PAYLOAD];  /* frame payload          */
+    uint8_t  size;                        /* payload size           */
+    bool     valid;                       /* slot holds a frame     */
+    bool     retransmitted;               /* sent more than once    */
+    uint8_t  retries;                     /* retransmit count       */
+    uint32_t sent_time_ms;                /* time of last send      */
+    uint32_t resend_mark;                 /* s_resend_count at send */
+    } arq_slot;                           /* window slot            */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+static arq_slot s_tx_window[LORA_ARQ_WINDOW_SIZE]; /* unacked frames */
+static arq_slot s_rx_window[LORA_ARQ_WINDOW_SIZE]; /* held frames    */
+static uint8_t  s_send_base       = 0;     /* oldest unacked seq        */
+static uint8_t  s_next_seq        = 0;     /* next seq to send          */
+static uint8_t  s_peer_base       = 0;     /* peer rx window base       */
+static uint8_t  s_deliver_base    = 0;     /* next seq to deliver       */
+static bool     s_ack_pending     = false; /* peer needs an ack T/F     */
+static bool     s_ack_now         = false; /* ack without delay T/F     */
+static uint32_t s_resend_count    = 0;     /* retransmits and probes    */
+static uint32_t s_last_rx_time_ms = 0;     /* time of last data frame   */
+static uint32_t s_probe_time_ms   = 0;     /* time of last data / probe */
+static uint32_t s_ack_delay_ms    = 0;     /* wait before lone ack      */
+static uint32_t s_min_rto_ms      = 0;     /* retransmit timeout floor  */
+static uint32_t s_rto_ms          = 0;     /* retransmit timeout        */
+static uint32_t s_srtt_ms         = 0;     /* smoothed round trip       */
+static uint32_t s_rttvar_ms       = 0;     /* round trip variation      */
+static bool     s_rtt_valid       = false; /* rtt sample taken T/F      */
+static bool     s_link_failed     = false; /* retries exhausted T/F     */
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+#define ARQ_SLOT( seq )         ( ( seq ) % LORA_ARQ_WINDOW_SIZE )
+                                           /* window slot of seq        */
+
+#define ARQ_OFFSET( seq, base ) ( (uint8_t)( ( seq ) - ( base ) ) )
+                                           /* seq distance, mod 256     */
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+static uint8_t arq_ack_bitmap
+    (
+    void
+    );
+
+static bool arq_transmit
+    (
+    arq_frame_type type,                  /* frame type             */
+    uint8_t        seq,                   /* sequence number        */
+    arq_slot      *slot                   /* payload, NULL for ack  */
+    );
+
+static void arq_update_rtt
+    (
+    uint32_t rtt_ms                       /* round trip sample      */
+    );
+
+static void arq_set_rto
+    (
+    void
+    );
+
+static void arq_process_ack
+    (
+    uint8_t  base,                        /* peer rx window base    */
+    uint8_t  bitmap,                      /* peer held frames       */
+    uint32_t current_time_ms              /* current time in ms     */
+    );
+
+static void arq_process_data
+    (
+    uint8_t  seq,                         /* sequence number        */
+    uint8_t  payload[],                   /* frame payload          */
+    uint8_t  size                         /* payload size           */
+    );
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       arq_ack_bitmap
+*
+*   DESCRIPTION:
+*       returns bitmap of frames held in the receive window
+*
+*********************************************************************/
+static uint8_t arq_ack_bitmap
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t bitmap;                 /* held frames            */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+bitmap = 0x00;
+
+for( i = 0; i < LORA_ARQ_WINDOW_SIZE; i++ )
+    {
+    if( s_rx_window[ARQ_SLOT( (uint8_t)( s_deliver_base + i ) )].valid )
+        {
+        bitmap |= ( 1 << i );
+        }
+    }
+
+return bitmap;
+
+} /* arq_ack_bitmap() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       arq_transmit
+*
+*   DESCRIPTION:
+*       sends a frame with current ack state and returns to
+*       continious rx
+*
+*********************************************************************/
+static bool arq_transmit
+    (
+    arq_frame_type type,                  /* frame type             */
+    uint8_t        seq,                   /* sequence number        */
+    arq_slot      *slot                   /* payload, NULL for ack  */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t frame[ARQ_FRAME_SIZE];  /* frame to send          */
+uint8_t frame_size;             /* bytes in frame         */
+bool    sent;                   /* tx result              */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Build header, ack state rides on every frame
+----------------------------------------------------------*/
+frame[0]   = type;
+frame[1]   = seq;
+frame[2]   = s_deliver_base;
+frame[3]   = arq_ack_bitmap();
+frame_size = ARQ_HEADER_SIZE;
+
+if( slot != NULL )
+    {
+    for( i = 0; i < slot->size; i++ )
+        {
+        frame[ARQ_HEADER_SIZE + i] = slot->data[i];
+        }
+    frame_size += slot->size;
+    }
+
+/*----------------------------------------------------------
+Send and go back to listening
+----------------------------------------------------------*/
+sent = lora_send_message( frame, frame_size );
+
+if( sent )
+    {
+    s_ack_pending = false;
+    s_ack_now     = false;
+    }
+
+if( !lora_init_continious_rx() )
+    {
+    return false;
+    }
+
+return sent;
+
+} /* arq_transmit() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       arq_update_rtt
+*
+*   DESCRIPTION:
+*       folds a round trip sample into the retransmit timeout
+*       (RFC 6298 smoothing)
+*
+*********************************************************************/
+static void arq_update_rtt
+    (
+    uint32_t rtt_ms                       /* round trip sample      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t deviation;             /* |srtt - sample|        */
+
+/*----------------------------------------------------------
+Smooth sample into estimate
+----------------------------------------------------------*/
+if( !s_rtt_valid )
+    {
+    s_srtt_ms   = rtt_ms;
+    s_rttvar_ms = rtt_ms / 2;
+    s_rtt_valid = true;
+    }
+else
+    {
+    deviation   = ( s_srtt_ms > rtt_ms ) ? ( s_srtt_ms - rtt_ms ) : ( rtt_ms - s_srtt_ms );
+    s_rttvar_ms = ( ( 3 * s_rttvar_ms ) + deviation ) / 4;
+    s_srtt_ms   = ( ( 7 * s_srtt_ms ) + rtt_ms ) / 8;
+    }
+
+arq_set_rto();
+
+} /* arq_update_rtt() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       arq_set_rto
+*
+*   DESCRIPTION:
+*       sets the retransmit timeout from the round trip estimate,
+*       undoing any backoff, or to the initial timeout before
+*       the first sample
+*
+*********************************************************************/
+static void arq_set_rto
+    (
+    void
+    )
+{
+if( !s_rtt_valid )
+    {
+    s_rto_ms = 2 * s_min_rto_ms;
+    return;
+    }
+
+/*----------------------------------------------------------
+Clamp timeout, never below the send time bound
+----------------------------------------------------------*/
+s_rto_ms = s_srtt_ms + ( 4 * s_rttvar_ms );
+
+if( s_rto_ms < s_min_rto_ms )
+    {
+    s_rto_ms = s_min_rto_ms;
+    }
+else if( s_rto_ms > ARQ_MAX_RTO_MS )
+    {
+    s_rto_ms = ARQ_MAX_RTO_MS;
+    }
+
+} /* arq_set_rto() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       arq_process_ack
+*
+*   DESCRIPTION:
+*       records the peer window base, marks frames acked by
+*       peer and slides the send window. Frames held in the
+*       bitmap are acked but the peer window only opens as its
+*       base moves. Only frames sent once, with no retransmit or
+*       probe since, give round trip samples (Karn). Any newly
+*       acked frame resets the timeout from the estimate.
+*
+*********************************************************************/
+static void arq_process_ack
+    (
+    uint8_t  base,                        /* peer rx window base    */
+    uint8_t  bitmap,                      /* peer held frames       */
+    uint32_t current_time_ms              /* current time in ms     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+arq_slot *slot;                 /* tx window slot         */
+uint8_t   seq;                  /* sequence number        */
+uint8_t   in_flight;            /* frames sent not acked  */
+bool      acked;                /* new data acked T/F     */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Ignore stale acks with a base behind the last advertised
+base or past what was sent. The base may still be behind
+s_send_base while the peer holds undelivered frames.
+----------------------------------------------------------*/
+if( ARQ_OFFSET( base, s_peer_base ) > ARQ_OFFSET( s_next_seq, s_peer_base ) )
+    {
+    return;
+    }
+
+s_peer_base = base;
+
+/*----------------------------------------------------------
+Everything before base is acked, plus frames in bitmap.
+Frames in flight are never more than a window past base.
+----------------------------------------------------------*/
+in_flight = ARQ_OFFSET( s_next_seq, s_send_base );
+acked     = false;
+
+for( i = 0; i < in_flight; i++ )
+    {
+    seq  = (uint8_t)( s_send_base + i );
+    slot = &s_tx_window[ARQ_SLOT( seq )];
+
+    if( !slot->valid )
+        {
+        continue;
+        }
+
+    if( ARQ_OFFSET( seq, base ) < LORA_ARQ_WINDOW_SIZE &&
+        ( bitmap & ( 1 << ARQ_OFFSET( seq, base ) ) ) == 0 )
+        {
+        continue;
+        }
+
+    if( !slot->retransmitted && slot->resend_mark == s_resend_count )
+        {
+        arq_update_rtt( current_time_ms - slot->sent_time_ms );
+        }
+    slot->valid = false;
+    acked       = true;
+    }
+
+/*----------------------------------------------------------
+Slide window past acked frames
+----------------------------------------------------------*/
+while( s_send_base != s_next_seq && !s_tx_window[ARQ_SLOT( s_send_base )].valid )
+    {
+    s_send_base++;
+    }
+
+/*----------------------------------------------------------
+Link is alive, retries only count timeouts without any
+progress
+----------------------------------------------------------*/
+if( acked )
+    {
+    arq_set_rto();
+
+    for( i = 0; i < ARQ_OFFSET( s_next_seq, s_send_base ); i++ )
+        {
+        s_tx_window[ARQ_SLOT( s_send_base + i )].retries = 0;
+        }
+    }
+
+} /* arq_process_ack() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       arq_process_data
+*
+*   DESCRIPTION:
+*       stores a data frame in the receive window. Frames outside
+*       the window and frames already held are dropped but acked
+*       at once so a peer that lost our ack stops resending.
+*
+*********************************************************************/
+static void arq_process_data
+    (
+    uint8_t  seq,                         /* sequence number        */
+    uint8_t  payload[],                   /* frame payload          */
+    uint8_t  size                         /* payload size           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+arq_slot *slot;                 /* rx window slot         */
+int i;                          /* interator              */
+
+s_ack_pending = true;
+
+if( size > LORA_ARQ_MAX_PAYLOAD )
+    {
+    return;
+    }
+
+if( ARQ_OFFSET( seq, s_deliver_base ) >= LORA_ARQ_WINDOW_SIZE )
+    {
+    s_ack_now = true;
+    return;
+    }
+
+/*----------------------------------------------------------
+Hold frame until delivered in order
+----------------------------------------------------------*/
+slot = &s_rx_window[ARQ_SLOT( seq )];
+if( slot->valid )
+    {
+    s_ack_now = true;
+    return;
+    }
+
+for( i = 0; i < size; i++ )
+    {
+    slot->data[i] = payload[i];
+    }
+slot->size  = size;
+slot->valid = true;
+
+} /* arq_process_data() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_arq_init
+*
+*   DESCRIPTION:
+*       resets both windows and derives timers from time on air
+*       at the current modem settings. Call after the modem is
+*       configured, and again after a link failure.
+*
+*********************************************************************/
+void lora_arq_init
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t data_tx_ms;            /* full data frame send    */
+uint32_t ack_tx_ms;             /* ack frame send          */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+data_tx_ms = ( lora_get_send_time_us( ARQ_FRAME_SIZE ) + US_PER_MS - 1 ) / US_PER_MS;
+ack_tx_ms  = ( lora_get_send_time_us( ARQ_HEADER_SIZE ) + US_PER_MS - 1 ) / US_PER_MS;
+
+/*----------------------------------------------------------
+Clear windows
+----------------------------------------------------------*/
+for( i = 0; i < LORA_ARQ_WINDOW_SIZE; i++ )
+    {
+    s_tx_window[i].valid = false;
+    s_rx_window[i].valid = false;
+    }
+
+s_send_base       = 0;
+s_next_seq        = 0;
+s_peer_base       = 0;
+s_deliver_base    = 0;
+s_ack_pending     = false;
+s_ack_now         = false;
+s_resend_count    = 0;
+s_last_rx_time_ms = 0;
+s_probe_time_ms   = 0;
+s_rtt_valid       = false;
+s_link_failed     = false;
+
+/*----------------------------------------------------------
+Ack is held for half a frame past the next expected frame
+so a burst is acked once. A full window burst plus the
+ack is the shortest possible round trip. Send times cover
+the driver mode switches as well as time on air.
+----------------------------------------------------------*/
+s_ack_delay_ms = data_tx_ms + ( data_tx_ms / 2 );
+s_min_rto_ms   = ( LORA_ARQ_WINDOW_SIZE * data_tx_ms ) + s_ack_delay_ms + ack_tx_ms;
+arq_set_rto();
+
+} /* lora_arq_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_arq_send
+*
+*   DESCRIPTION:
+*       queues a message and sends it immediately. Returns false
+*       if the peer window is full, the message is too big or
+*       the link has failed.
+*
+*********************************************************************/
+bool lora_arq_send
+    (
+    uint8_t  Message[],                   /* array of bytes to send */
+    uint8_t  number_of_bytes,             /* size of array          */
+    uint32_t current_time_ms              /* current time in ms     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+arq_slot *slot;                 /* tx window slot         */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Verify message can be queued and the peer has room for it
+----------------------------------------------------------*/
+if( s_link_failed                                                ||
+    number_of_bytes > LORA_ARQ_MAX_PAYLOAD                       ||
+    ARQ_OFFSET( s_next_seq, s_peer_base ) >= LORA_ARQ_WINDOW_SIZE )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Copy into window
+----------------------------------------------------------*/
+slot = &s_tx_window[ARQ_SLOT( s_next_seq )];
+
+for( i = 0; i < number_of_bytes; i++ )
+    {
+    slot->data[i] = Message[i];
+    }
+slot->size          = number_of_bytes;
+slot->valid         = true;
+slot->retransmitted = false;
+slot->retries       = 0;
+slot->sent_time_ms  = current_time_ms;
+slot->resend_mark   = s_resend_count;
+s_probe_time_ms     = current_time_ms;
+
+/*----------------------------------------------------------
+Send now, a failed tx is covered by retransmission
+----------------------------------------------------------*/
+arq_transmit( ARQ_FRAME_DATA, s_next_seq, slot );
+s_next_seq++;
+
+return true;
+
+} /* lora_arq_send() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_arq_poll
+*
+*   DESCRIPTION:
+*       receives frames, retransmits expired frames and sends
+*       delayed acks. Call often. Returns false once a frame
+*       exceeds LORA_ARQ_MAX_RETRIES with no ack of new data.
+*
+*********************************************************************/
+bool lora_arq_poll
+    (
+    uint32_t current_time_ms              /* current time in ms     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t     frame[ARQ_FRAME_SIZE]; /* received frame      */
+uint8_t     frame_size;            /* received frame size */
+lora_errors error;                 /* rx error            */
+arq_slot   *slot;                  /* tx window slot      */
+uint8_t     seq;                   /* sequence number     */
+bool        timed_out;             /* any frame expired   */
+int i;                             /* interator           */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+frame_size = 0;
+error      = RX_NO_ERROR;
+timed_out  = false;
+
+if( s_link_failed )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Process received frame
+----------------------------------------------------------*/
+if( lora_get_message( frame, sizeof( frame ), &frame_size, &error ) &&
+    error == RX_NO_ERROR && frame_size >= ARQ_HEADER_SIZE )
+    {
+    if( frame[0] == ARQ_FRAME_DATA  ||
+        frame[0] == ARQ_FRAME_ACK   ||
+        frame[0] == ARQ_FRAME_PROBE )
+        {
+        arq_process_ack( frame[2], frame[3], current_time_ms );
+        }
+
+    if( frame[0] == ARQ_FRAME_DATA )
+        {
+        arq_process_data( frame[1], &frame[ARQ_HEADER_SIZE], frame_size - ARQ_HEADER_SIZE );
+        s_last_rx_time_ms = current_time_ms;
+        }
+    else if( frame[0] == ARQ_FRAME_PROBE )
+        {
+        s_ack_pending = true;
+        s_ack_now     = true;
+        }
+    }
+
+/*----------------------------------------------------------
+Retransmit only frames whose timeout expired
+----------------------------------------------------------*/
+for( i = 0; i < ARQ_OFFSET( s_next_seq, s_send_base ); i++ )
+    {
+    seq  = (uint8_t)( s_send_base + i );
+    slot = &s_tx_window[ARQ_SLOT( seq )];
+
+    if( !slot->valid || ( current_time_ms - slot->sent_time_ms ) < s_rto_ms )
+        {
+        continue;
+        }
+
+    if( slot->retries >= LORA_ARQ_MAX_RETRIES )
+        {
+        s_link_failed = true;
+        return false;
+        }
+
+    slot->retries++;
+    slot->retransmitted = true;
+    slot->sent_time_ms  = current_time_ms;
+    timed_out           = true;
+    s_resend_count++;
+    arq_transmit( ARQ_FRAME_DATA, seq, slot );
+    }
+
+/*----------------------------------------------------------
+Back off once per poll that saw a timeout
+----------------------------------------------------------*/
+if( timed_out )
+    {
+    s_rto_ms = ( 2 * s_rto_ms > ARQ_MAX_RTO_MS ) ? ARQ_MAX_RTO_MS : ( 2 * s_rto_ms );
+    }
+
+/*----------------------------------------------------------
+Probe a closed peer window once everything sent is acked,
+in case the ack that opened it was lost
+----------------------------------------------------------*/
+if( ARQ_OFFSET( s_next_seq, s_peer_base ) >= LORA_ARQ_WINDOW_SIZE &&
+    s_send_base == s_next_seq                                     &&
+    ( current_time_ms - s_probe_time_ms ) >= s_rto_ms             )
+    {
+    s_probe_time_ms = current_time_ms;
+    s_resend_count++;
+    arq_transmit( ARQ_FRAME_PROBE, 0, NULL );
+    }
+
+/*----------------------------------------------------------
+Send standalone ack if nothing carried it
+----------------------------------------------------------*/
+if( s_ack_pending &&
+    ( s_ack_now || ( current_time_ms - s_last_rx_time_ms ) >= s_ack_delay_ms ) )
+    {
+    arq_transmit( ARQ_FRAME_ACK, 0, NULL );
+    }
+
+return true;
+
+} /* lora_arq_poll() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_arq_get_message
+*
+*   DESCRIPTION:
+*       returns next in order message. Same return and error
+*       behavior as lora_get_message().
+*
+*********************************************************************/
+bool lora_arq_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+arq_slot *slot;                 /* rx window slot         */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize variables
+----------------------------------------------------------*/
+*error = RX_NO_ERROR;
+*size  = 0;
+
+slot = &s_rx_window[ARQ_SLOT( s_deliver_base )];
+if( !slot->valid )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Verify message[] can fit message received
+----------------------------------------------------------*/
+if( slot->size > size_of_message )
+    {
+    *error = RX_ARRAY_SIZE_ERR;
+    }
+else
+    {
+    for( i = 0; i < slot->size; i++ )
+        {
+        message[i] = slot->data[i];
+        }
+    *size = slot->size;
+    }
+
+/*----------------------------------------------------------
+Slide window and let peer know space opened up
+----------------------------------------------------------*/
+slot->valid = false;
+s_deliver_base++;
+s_ack_pending = true;
+
+return true;
+
+} /* lora_arq_get_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_arq_in_flight
+*
+*   DESCRIPTION:
+*       returns number of frames sent and not yet acked
+*
+*********************************************************************/
+uint8_t lora_arq_in_flight
+    (
+    void
+    )
+{
+return ARQ_OFFSET( s_next_seq, s_send_base );
+
+} /* lora_arq_in_flight() */
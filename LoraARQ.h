@@ -0,0 +1,87 @@
+/*********************************************************************
+*
+*   HEADER:
+*       header file for loraARQ
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+#ifndef LORA_ARQ_H
+#define LORA_ARQ_H
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define LORA_ARQ_WINDOW_SIZE    ( 8 )      /* frames in flight, must
+                                              match ack bitmap width    */
+
+#define LORA_ARQ_MAX_PAYLOAD    ( 32 )     /* max bytes per frame       */
+
+#define LORA_ARQ_MAX_RETRIES    ( 16 )     /* retransmits without an ack
+                                              of new data before link
+                                              is declared failed        */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+loraARQ.c
+--------------------------------------------------------------------*/
+void lora_arq_init
+    (
+    void
+    );
+
+bool lora_arq_send
+    (
+    uint8_t  Message[],                   /* array of bytes to send */
+    uint8_t  number_of_bytes,             /* size of array          */
+    uint32_t current_time_ms              /* current time in ms     */
+    );
+
+bool lora_arq_poll
+    (
+    uint32_t current_time_ms              /* current time in ms     */
+    );
+
+bool lora_arq_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    );
+
+uint8_t lora_arq_in_flight
+    (
+    void
+    );
+
+#endif /* LORA_ARQ_H */
+
+/* LoraARQ.h */
@@ -0,0 +1,1076 @@
+/*********************************************************************
+*
+*   NAME:
+*       loraCrypto.c
+*
+*   DESCRIPTION:
+*       Authenticated encryption for the LoRa API using
+*       ChaCha20-Poly1305 (RFC 8439) with the tag truncated to
+*       LORA_CRYPTO_TAG_SIZE bytes. ChaCha20 needs only 32 bit
+*       add / xor / rotate, which suits the Cortex-M4F without
+*       crypto hardware.
+*
+*       The nonce is the sender id and a per sender frame
+*       counter, both known before the frame exists, so the
+*       keystream and Poly1305 key for the next tx frame (and
+*       next expected rx frame) are generated while the radio is
+*       idle. Sending then only costs an xor and Poly1305.
+*
+*       Frame layout:
+*           byte 0      - sender id
+*           byte 1-4    - frame counter, LSB first
+*           byte 5+     - ciphertext
+*           last 8      - tag over header and ciphertext
+*
+*       Failed authentication or a replayed counter is reported
+*       as RX_KEY_ERR. The replay table holds a counter for every
+*       possible sender id, so no sender can be pushed out of it.
+*
+*       The tx counter must never repeat under one key, including
+*       across reboots. Nothing is sent until lora_crypto_init()
+*       supplies a starting counter. The application stores
+*       lora_crypto_get_tx_counter() in non-volatile memory and
+*       passes it back at the next boot.
+*
+*       The replay table is cleared by lora_crypto_init() as
+*       well, which would let a recorded frame be replayed after
+*       a reboot. The application also stores
+*       lora_crypto_get_rx_counter() for every sender it expects
+*       to hear, and restores each one with
+*       lora_crypto_set_rx_counter() after lora_crypto_init().
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+#include "LoraCrypto.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define CHACHA_BLOCK_SIZE       ( 64 )     /* keystream block bytes     */
+
+#define CHACHA_NONCE_SIZE       ( 12 )     /* RFC 8439 nonce bytes      */
+
+#define CHACHA_DOUBLE_ROUNDS    ( 10 )     /* ChaCha20                  */
+
+#define POLY_KEY_SIZE           ( 32 )     /* one time Poly1305 key     */
+
+#define POLY_BLOCK_SIZE         ( 16 )     /* Poly1305 block bytes      */
+
+#define POLY_LIMB_MASK          ( 0x3FFFFFF )
+                                           /* 26 bit limb               */
+
+#define KEYSTREAM_SIZE          ( ( ( LORA_CRYPTO_MAX_PAYLOAD + CHACHA_BLOCK_SIZE - 1 ) / CHACHA_BLOCK_SIZE ) * CHACHA_BLOCK_SIZE )
+                                           /* keystream for largest
+                                              payload                   */
+
+#define CRYPTO_FRAME_SIZE       ( LORA_CRYPTO_HEADER_SIZE + LORA_CRYPTO_MAX_PAYLOAD + LORA_CRYPTO_TAG_SIZE )
+                                           /* largest frame on air      */
+
+#define DEMCR_TRCENA            ( 0x01000000 )
+                                           /* enable DWT                */
+
+#define DWT_CYCCNTENA           ( 0x00000001 )
+                                           /* enable cycle counter      */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef struct
+    {
+    bool     ready;                       /* keystream generated    */
+    uint8_t  sender;                      /* nonce sender id        */
+    uint32_t counter;                     /* nonce frame counter    */
+    uint8_t  poly_key[POLY_KEY_SIZE];     /* block 0, MAC key       */
+    uint8_t  stream[KEYSTREAM_SIZE];      /* block 1+, cipher       */
+    } crypto_keystream;                   /* keystream for a nonce  */
+
+typedef struct
+    {
+    uint32_t r[5];                        /* clamped key, 26b limbs */
+    uint32_t h[5];                        /* accumulator            */
+    uint32_t pad[4];                      /* final key half         */
+    } poly1305_state;                     /* Poly1305 state         */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+static uint32_t s_key[LORA_CRYPTO_KEY_SIZE / 4]; /* key as words     */
+static uint8_t  s_node_id         = 0;     /* this node's sender id     */
+static uint32_t s_tx_counter      = 0;     /* next tx frame counter     */
+static bool     s_tx_counter_set  = false; /* start counter given T/F   */
+static crypto_keystream s_tx;              /* next tx keystream         */
+static crypto_keystream s_rx;              /* expected rx keystream     */
+static bool     s_rx_expected     = false; /* rx nonce guess valid T/F  */
+static uint8_t  s_rx_sender       = 0;     /* expected rx sender        */
+static uint32_t s_rx_counter      = 0;     /* expected rx counter       */
+static uint32_t s_rx_next[LORA_CRYPTO_SENDERS];
+                                           /* least counter accepted
+                                              per sender id             */
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+#define ROTL32( v, n )          ( ( ( v ) << ( n ) ) | ( ( v ) >> ( 32 - ( n ) ) ) )
+                                           /* rotate left               */
+
+#define LOAD32_LE( p )          ( (uint32_t)( p )[0]         | \
+                                  ( (uint32_t)( p )[1] << 8 )  | \
+                                  ( (uint32_t)( p )[2] << 16 ) | \
+                                  ( (uint32_t)( p )[3] << 24 ) )
+                                           /* little endian load        */
+
+#define QUARTER_ROUND( a, b, c, d ) \
+    a += b; d ^= a; d = ROTL32( d, 16 ); \
+    c += d; b ^= c; b = ROTL32( b, 12 ); \
+    a += b; d ^= a; d = ROTL32( d, 8 );  \
+    c += d; b ^= c; b = ROTL32( b, 7 )
+                                           /* ChaCha quarter round      */
+
+#define DEMCR_R                 ( *( (volatile uint32_t *)0xE000EDFC ) )
+                                           /* debug exception control   */
+
+#define DWT_CTRL_R              ( *( (volatile uint32_t *)0xE0001000 ) )
+                                           /* DWT control               */
+
+#define DWT_CYCCNT_R            ( *( (volatile uint32_t *)0xE0001004 ) )
+                                           /* DWT cycle counter         */
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+static void store32_le
+    (
+    uint8_t  out[],                       /* destination            */
+    uint32_t value                        /* value to store         */
+    );
+
+static void chacha20_block
+    (
+    uint8_t  nonce[],                     /* 12 byte nonce          */
+    uint32_t block,                       /* block counter          */
+    uint8_t  out[]                        /* 64 byte output         */
+    );
+
+static void crypto_generate
+    (
+    crypto_keystream *keystream,          /* keystream to fill      */
+    uint8_t           sender,             /* nonce sender id        */
+    uint32_t          counter             /* nonce frame counter    */
+    );
+
+static void poly1305_init
+    (
+    poly1305_state *state,                /* state to set up        */
+    uint8_t         key[]                 /* 32 byte one time key   */
+    );
+
+static void poly1305_block
+    (
+    poly1305_state *state,                /* MAC state              */
+    uint8_t         block[]               /* 16 byte block          */
+    );
+
+static void poly1305_update_padded
+    (
+    poly1305_state *state,                /* MAC state              */
+    uint8_t         data[],               /* data to MAC            */
+    uint8_t         size                  /* size of data           */
+    );
+
+static void poly1305_finish
+    (
+    poly1305_state *state,                /* MAC state              */
+    uint8_t         tag[]                 /* 16 byte tag            */
+    );
+
+static void crypto_tag
+    (
+    crypto_keystream *keystream,          /* keystream of frame     */
+    uint8_t           frame[],            /* header + ciphertext    */
+    uint8_t           size,               /* ciphertext size        */
+    uint8_t           tag[]               /* 16 byte tag            */
+    );
+
+static bool crypto_check_replay
+    (
+    uint8_t  sender,                      /* sender id              */
+    uint32_t counter                      /* frame counter          */
+    );
+
+static void crypto_accept_counter
+    (
+    uint8_t  sender,                      /* sender id              */
+    uint32_t counter                      /* frame counter          */
+    );
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       store32_le
+*
+*   DESCRIPTION:
+*       stores a word little endian
+*
+*********************************************************************/
+static void store32_le
+    (
+    uint8_t  out[],                       /* destination            */
+    uint32_t value                        /* value to store         */
+    )
+{
+out[0] = (uint8_t)( value );
+out[1] = (uint8_t)( value >> 8 );
+out[2] = (uint8_t)( value >> 16 );
+out[3] = (uint8_t)( value >> 24 );
+
+} /* store32_le() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       chacha20_block
+*
+*   DESCRIPTION:
+*       generates one ChaCha20 keystream block (RFC 8439 2.3)
+*
+*********************************************************************/
+static void chacha20_block
+    (
+    uint8_t  nonce[],                     /* 12 byte nonce          */
+    uint32_t block,                       /* block counter          */
+    uint8_t  out[]                        /* 64 byte output         */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t state[16];             /* input state            */
+uint32_t x[16];                 /* working state          */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+"expand 32-byte k", key, counter, nonce
+----------------------------------------------------------*/
+state[0]  = 0x61707865;
+state[1]  = 0x3320646E;
+state[2]  = 0x79622D32;
+state[3]  = 0x6B206574;
+
+for( i = 0; i < 8; i++ )
+    {
+    state[4 + i] = s_key[i];
+    }
+
+state[12] = block;
+state[13] = LOAD32_LE( &nonce[0] );
+state[14] = LOAD32_LE( &nonce[4] );
+state[15] = LOAD32_LE( &nonce[8] );
+
+for( i = 0; i < 16; i++ )
+    {
+    x[i] = state[i];
+    }
+
+/*----------------------------------------------------------
+Column and diagonal rounds
+----------------------------------------------------------*/
+for( i = 0; i < CHACHA_DOUBLE_ROUNDS; i++ )
+    {
+    QUARTER_ROUND( x[0], x[4], x[8],  x[12] );
+    QUARTER_ROUND( x[1], x[5], x[9],  x[13] );
+    QUARTER_ROUND( x[2], x[6], x[10], x[14] );
+    QUARTER_ROUND( x[3], x[7], x[11], x[15] );
+    QUARTER_ROUND( x[0], x[5], x[10], x[15] );
+    QUARTER_ROUND( x[1], x[6], x[11], x[12] );
+    QUARTER_ROUND( x[2], x[7], x[8],  x[13] );
+    QUARTER_ROUND( x[3], x[4], x[9],  x[14] );
+    }
+
+for( i = 0; i < 16; i++ )
+    {
+    store32_le( &out[4 * i], x[i] + state[i] );
+    }
+
+} /* chacha20_block() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       crypto_generate
+*
+*   DESCRIPTION:
+*       generates Poly1305 key (block 0) and cipher keystream
+*       (block 1 on) for a nonce
+*
+*********************************************************************/
+static void crypto_generate
+    (
+    crypto_keystream *keystream,          /* keystream to fill      */
+    uint8_t           sender,             /* nonce sender id        */
+    uint32_t          counter             /* nonce frame counter    */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t nonce[CHACHA_NONCE_SIZE];    /* frame nonce       */
+uint8_t block[CHACHA_BLOCK_SIZE];    /* block 0 output    */
+int i;                               /* interator         */
+
+/*----------------------------------------------------------
+Nonce is sender id, counter, zero padding
+----------------------------------------------------------*/
+for( i = 0; i < CHACHA_NONCE_SIZE; i++ )
+    {
+    nonce[i] = 0;
+    }
+nonce[0] = sender;
+store32_le( &nonce[1], counter );
+
+chacha20_block( nonce, 0, block );
+for( i = 0; i < POLY_KEY_SIZE; i++ )
+    {
+    keystream->poly_key[i] = block[i];
+    }
+
+for( i = 0; i < KEYSTREAM_SIZE / CHACHA_BLOCK_SIZE; i++ )
+    {
+    chacha20_block( nonce, i + 1, &keystream->stream[i * CHACHA_BLOCK_SIZE] );
+    }
+
+keystream->sender  = sender;
+keystream->counter = counter;
+keystream->ready   = true;
+
+} /* crypto_generate() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       poly1305_init
+*
+*   DESCRIPTION:
+*       clamps r and loads it as 26 bit limbs
+*
+*********************************************************************/
+static void poly1305_init
+    (
+    poly1305_state *state,                /* state to set up        */
+    uint8_t         key[]                 /* 32 byte one time key   */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int i;                          /* interator              */
+
+state->r[0] = ( LOAD32_LE( &key[0] )       ) & 0x3FFFFFF;
+state->r[1] = ( LOAD32_LE( &key[3] )  >> 2 ) & 0x3FFFF03;
+state->r[2] = ( LOAD32_LE( &key[6] )  >> 4 ) & 0x3FFC0FF;
+state->r[3] = ( LOAD32_LE( &key[9] )  >> 6 ) & 0x3F03FFF;
+state->r[4] = ( LOAD32_LE( &key[12] ) >> 8 ) & 0x00FFFFF;
+
+for( i = 0; i < 5; i++ )
+    {
+    state->h[i] = 0;
+    }
+
+for( i = 0; i < 4; i++ )
+    {
+    state->pad[i] = LOAD32_LE( &key[16 + ( 4 * i )] );
+    }
+
+} /* poly1305_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       poly1305_block
+*
+*   DESCRIPTION:
+*       h = ( h + block ) * r mod 2^130 - 5 for one full block
+*
+*********************************************************************/
+static void poly1305_block
+    (
+    poly1305_state *state,                /* MAC state              */
+    uint8_t         block[]               /* 16 byte block          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t r0, r1, r2, r3, r4;    /* key limbs              */
+uint32_t s1, s2, s3, s4;        /* key limbs * 5          */
+uint32_t h0, h1, h2, h3, h4;    /* accumulator limbs      */
+uint64_t d0, d1, d2, d3, d4;    /* products               */
+uint32_t c;                     /* carry                  */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+r0 = state->r[0];
+r1 = state->r[1];
+r2 = state->r[2];
+r3 = state->r[3];
+r4 = state->r[4];
+s1 = r1 * 5;
+s2 = r2 * 5;
+s3 = r3 * 5;
+s4 = r4 * 5;
+
+/*----------------------------------------------------------
+Add block with the 2^128 bit set
+----------------------------------------------------------*/
+h0 = state->h[0] + ( ( LOAD32_LE( &block[0] )       ) & POLY_LIMB_MASK );
+h1 = state->h[1] + ( ( LOAD32_LE( &block[3] )  >> 2 ) & POLY_LIMB_MASK );
+h2 = state->h[2] + ( ( LOAD32_LE( &block[6] )  >> 4 ) & POLY_LIMB_MASK );
+h3 = state->h[3] + ( ( LOAD32_LE( &block[9] )  >> 6 ) & POLY_LIMB_MASK );
+h4 = state->h[4] + ( ( LOAD32_LE( &block[12] ) >> 8 ) | ( 1UL << 24 ) );
+
+/*----------------------------------------------------------
+Multiply by r
+----------------------------------------------------------*/
+d0 = ( (uint64_t)h0 * r0 ) + ( (uint64_t)h1 * s4 ) + ( (uint64_t)h2 * s3 ) + ( (uint64_t)h3 * s2 ) + ( (uint64_t)h4 * s1 );
+d1 = ( (uint64_t)h0 * r1 ) + ( (uint64_t)h1 * r0 ) + ( (uint64_t)h2 * s4 ) + ( (uint64_t)h3 * s3 ) + ( (uint64_t)h4 * s2 );
+d2 = ( (uint64_t)h0 * r2 ) + ( (uint64_t)h1 * r1 ) + ( (uint64_t)h2 * r0 ) + ( (uint64_t)h3 * s4 ) + ( (uint64_t)h4 * s3 );
+d3 = ( (uint64_t)h0 * r3 ) + ( (uint64_t)h1 * r2 ) + ( (uint64_t)h2 * r1 ) + ( (uint64_t)h3 * r0 ) + ( (uint64_t)h4 * s4 );
+d4 = ( (uint64_t)h0 * r4 ) + ( (uint64_t)h1 * r3 ) + ( (uint64_t)h2 * r2 ) + ( (uint64_t)h3 * r1 ) + ( (uint64_t)h4 * r0 );
+
+/*----------------------------------------------------------
+Partial reduction mod 2^130 - 5
+----------------------------------------------------------*/
+c = (uint32_t)( d0 >> 26 ); h0 = (uint32_t)d0 & POLY_LIMB_MASK;
+d1 += c; c = (uint32_t)( d1 >> 26 ); h1 = (uint32_t)d1 & POLY_LIMB_MASK;
+d2 += c; c = (uint32_t)( d2 >> 26 ); h2 = (uint32_t)d2 & POLY_LIMB_MASK;
+d3 += c; c = (uint32_t)( d3 >> 26 ); h3 = (uint32_t)d3 & POLY_LIMB_MASK;
+d4 += c; c = (uint32_t)( d4 >> 26 ); h4 = (uint32_t)d4 & POLY_LIMB_MASK;
+h0 += c * 5; c = h0 >> 26; h0 &= POLY_LIMB_MASK;
+h1 += c;
+
+state->h[0] = h0;
+state->h[1] = h1;
+state->h[2] = h2;
+state->h[3] = h3;
+state->h[4] = h4;
+
+} /* poly1305_block() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       poly1305_update_padded
+*
+*   DESCRIPTION:
+*       MACs data zero padded to a whole block, as RFC 8439
+*       AEAD does for AAD and ciphertext
+*
+*********************************************************************/
+static void poly1305_update_padded
+    (
+    poly1305_state *state,                /* MAC state              */
+    uint8_t         data[],               /* data to MAC            */
+    uint8_t         size                  /* size of data           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t block[POLY_BLOCK_SIZE]; /* padded last block      */
+uint8_t offset;                 /* bytes processed        */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+offset = 0;
+
+while( size - offset >= POLY_BLOCK_SIZE )
+    {
+    poly1305_block( state, &data[offset] );
+    offset += POLY_BLOCK_SIZE;
+    }
+
+if( offset == size )
+    {
+    return;
+    }
+
+for( i = 0; i < POLY_BLOCK_SIZE; i++ )
+    {
+    block[i] = ( offset + i < size ) ? data[offset + i] : 0;
+    }
+
+poly1305_block( state, block );
+
+} /* poly1305_update_padded() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       poly1305_finish
+*
+*   DESCRIPTION:
+*       fully reduces h and adds the pad to produce the tag
+*
+*********************************************************************/
+static void poly1305_finish
+    (
+    poly1305_state *state,                /* MAC state              */
+    uint8_t         tag[]                 /* 16 byte tag            */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t h0, h1, h2, h3, h4;    /* accumulator limbs      */
+uint32_t g0, g1, g2, g3, g4;    /* h + 5 - 2^130          */
+uint32_t c;                     /* carry                  */
+uint32_t mask;                  /* select h or g          */
+uint64_t f;                     /* sum with pad           */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+h0 = state->h[0];
+h1 = state->h[1];
+h2 = state->h[2];
+h3 = state->h[3];
+h4 = state->h[4];
+
+/*----------------------------------------------------------
+Carry through
+----------------------------------------------------------*/
+c = h1 >> 26; h1 &= POLY_LIMB_MASK;
+h2 += c; c = h2 >> 26; h2 &= POLY_LIMB_MASK;
+h3 += c; c = h3 >> 26; h3 &= POLY_LIMB_MASK;
+h4 += c; c = h4 >> 26; h4 &= POLY_LIMB_MASK;
+h0 += c * 5; c = h0 >> 26; h0 &= POLY_LIMB_MASK;
+h1 += c;
+
+/*----------------------------------------------------------
+Constant time select of h or h - p
+----------------------------------------------------------*/
+g0 = h0 + 5; c = g0 >> 26; g0 &= POLY_LIMB_MASK;
+g1 = h1 + c; c = g1 >> 26; g1 &= POLY_LIMB_MASK;
+g2 = h2 + c; c = g2 >> 26; g2 &= POLY_LIMB_MASK;
+g3 = h3 + c; c = g3 >> 26; g3 &= POLY_LIMB_MASK;
+g4 = h4 + c - ( 1UL << 26 );
+
+mask = ( g4 >> 31 ) - 1;
+h0   = ( h0 & ~mask ) | ( g0 & mask );
+h1   = ( h1 & ~mask ) | ( g1 & mask );
+h2   = ( h2 & ~mask ) | ( g2 & mask );
+h3   = ( h3 & ~mask ) | ( g3 & mask );
+h4   = ( h4 & ~mask ) | ( g4 & mask );
+
+/*----------------------------------------------------------
+Pack to 128 bits and add pad
+----------------------------------------------------------*/
+h0 = ( h0       ) | ( h1 << 26 );
+h1 = ( h1 >> 6  ) | ( h2 << 20 );
+h2 = ( h2 >> 12 ) | ( h3 << 14 );
+h3 = ( h3 >> 18 ) | ( h4 << 8 );
+
+f = (uint64_t)h0 + state->pad[0];             store32_le( &tag[0],  (uint32_t)f );
+f = (uint64_t)h1 + state->pad[1] + ( f >> 32 ); store32_le( &tag[4],  (uint32_t)f );
+f = (uint64_t)h2 + state->pad[2] + ( f >> 32 ); store32_le( &tag[8],  (uint32_t)f );
+f = (uint64_t)h3 + state->pad[3] + ( f >> 32 ); store32_le( &tag[12], (uint32_t)f );
+
+} /* poly1305_finish() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       crypto_tag
+*
+*   DESCRIPTION:
+*       RFC 8439 AEAD tag with the frame header as AAD
+*
+*********************************************************************/
+static void crypto_tag
+    (
+    crypto_keystream *keystream,          /* keystream of frame     */
+    uint8_t           frame[],            /* header + ciphertext    */
+    uint8_t           size,               /* ciphertext size        */
+    uint8_t           tag[]               /* 16 byte tag            */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+poly1305_state state;                /* MAC state         */
+uint8_t        lengths[POLY_BLOCK_SIZE]; /* length block  */
+int i;                               /* interator         */
+
+/*----------------------------------------------------------
+AAD, ciphertext, then 64 bit lengths of each
+----------------------------------------------------------*/
+poly1305_init( &state, keystream->poly_key );
+poly1305_update_padded( &state, frame, LORA_CRYPTO_HEADER_SIZE );
+poly1305_update_padded( &state, &frame[LORA_CRYPTO_HEADER_SIZE], size );
+
+for( i = 0; i < POLY_BLOCK_SIZE; i++ )
+    {
+    lengths[i] = 0;
+    }
+lengths[0] = LORA_CRYPTO_HEADER_SIZE;
+lengths[8] = size;
+
+poly1305_block( &state, lengths );
+poly1305_finish( &state, tag );
+
+} /* crypto_tag() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       crypto_check_replay
+*
+*   DESCRIPTION:
+*       returns false if counter is not newer than the last
+*       frame accepted from sender
+*
+*********************************************************************/
+static bool crypto_check_replay
+    (
+    uint8_t  sender,                      /* sender id              */
+    uint32_t counter                      /* frame counter          */
+    )
+{
+return ( counter >= s_rx_next[sender] );
+
+} /* crypto_check_replay() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       crypto_accept_counter
+*
+*   DESCRIPTION:
+*       records last authenticated counter of sender. Senders
+*       never use UINT32_MAX, so the next counter cannot wrap.
+*
+*********************************************************************/
+static void crypto_accept_counter
+    (
+    uint8_t  sender,                      /* sender id              */
+    uint32_t counter                      /* frame counter          */
+    )
+{
+s_rx_next[sender] = counter + 1;
+
+} /* crypto_accept_counter() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_init
+*
+*   DESCRIPTION:
+*       loads network key, clears the replay table and
+*       precomputes the first tx keystream. node_id must be
+*       unique per key, and tx_counter must be above every
+*       counter this node has sent under the key, so nonces are
+*       never reused. Restore the saved replay table with
+*       lora_crypto_set_rx_counter() afterwards.
+*
+*********************************************************************/
+void lora_crypto_init
+    (
+    uint8_t  key[],                       /* shared network key     */
+    uint8_t  node_id,                     /* unique id of this node */
+    uint32_t tx_counter                   /* first tx frame counter,
+                                             0 only for a new key   */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int i;                          /* interator              */
+
+for( i = 0; i < LORA_CRYPTO_KEY_SIZE / 4; i++ )
+    {
+    s_key[i] = LOAD32_LE( &key[4 * i] );
+    }
+
+for( i = 0; i < LORA_CRYPTO_SENDERS; i++ )
+    {
+    s_rx_next[i] = 0;
+    }
+
+s_node_id        = node_id;
+s_tx_counter     = tx_counter;
+s_tx_counter_set = true;
+s_tx.ready       = false;
+s_rx.ready    = false;
+s_rx_expected = false;
+
+lora_crypto_precompute();
+
+} /* lora_crypto_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_get_tx_counter
+*
+*   DESCRIPTION:
+*       returns counter of the next tx frame. Store it before
+*       power is lost and pass it to lora_crypto_init() at the
+*       next boot. Storing a value ahead of it saves a write per
+*       frame, at the cost of skipped counters.
+*
+*********************************************************************/
+uint32_t lora_crypto_get_tx_counter
+    (
+    void
+    )
+{
+return s_tx_counter;
+
+} /* lora_crypto_get_tx_counter() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_get_rx_counter
+*
+*   DESCRIPTION:
+*       returns lowest counter still accepted from sender. Store
+*       it before power is lost and pass it to
+*       lora_crypto_set_rx_counter() at the next boot. Unlike the
+*       tx counter, a stored value must not be ahead of it, or
+*       valid frames from sender are rejected.
+*
+*********************************************************************/
+uint32_t lora_crypto_get_rx_counter
+    (
+    uint8_t sender                        /* sender id              */
+    )
+{
+return s_rx_next[sender];
+
+} /* lora_crypto_get_rx_counter() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_set_rx_counter
+*
+*   DESCRIPTION:
+*       restores a replay table entry saved with
+*       lora_crypto_get_rx_counter(). Call after
+*       lora_crypto_init(). The entry only moves forward, so a
+*       stale value can not reopen counters already accepted.
+*
+*********************************************************************/
+void lora_crypto_set_rx_counter
+    (
+    uint8_t  sender,                      /* sender id              */
+    uint32_t counter                      /* lowest counter still
+                                             accepted               */
+    )
+{
+if( counter > s_rx_next[sender] )
+    {
+    s_rx_next[sender] = counter;
+    }
+
+} /* lora_crypto_set_rx_counter() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_precompute
+*
+*   DESCRIPTION:
+*       generates keystream for the next tx frame and the next
+*       frame expected from the last sender heard. Call while
+*       the radio is idle.
+*
+*********************************************************************/
+void lora_crypto_precompute
+    (
+    void
+    )
+{
+if( s_tx_counter_set && !s_tx.ready )
+    {
+    crypto_generate( &s_tx, s_node_id, s_tx_counter );
+    }
+
+if( s_rx_expected && !s_rx.ready )
+    {
+    crypto_generate( &s_rx, s_rx_sender, s_rx_counter );
+    }
+
+} /* lora_crypto_precompute() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_send_message
+*
+*   DESCRIPTION:
+*       encrypts and tags message then sends it. Uses the
+*       precomputed keystream when available and precomputes the
+*       next one once the radio is idle again.
+*
+*********************************************************************/
+bool lora_crypto_send_message
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t frame[CRYPTO_FRAME_SIZE];       /* frame to send  */
+uint8_t tag[POLY_BLOCK_SIZE];           /* full tag       */
+bool    sent;                           /* tx result      */
+int i;                                  /* interator      */
+
+/*----------------------------------------------------------
+Verify message fits and the counter is set and has not run
+out
+----------------------------------------------------------*/
+if( number_of_bytes > LORA_CRYPTO_MAX_PAYLOAD ||
+    !s_tx_counter_set                         ||
+    s_tx_counter == UINT32_MAX                )
+    {
+    return false;
+    }
+
+if( !s_tx.ready )
+    {
+    crypto_generate( &s_tx, s_node_id, s_tx_counter );
+    }
+
+/*----------------------------------------------------------
+Header, ciphertext, truncated tag
+----------------------------------------------------------*/
+frame[0] = s_node_id;
+store32_le( &frame[1], s_tx_counter );
+
+for( i = 0; i < number_of_bytes; i++ )
+    {
+    frame[LORA_CRYPTO_HEADER_SIZE + i] = Message[i] ^ s_tx.stream[i];
+    }
+
+crypto_tag( &s_tx, frame, number_of_bytes, tag );
+
+for( i = 0; i < LORA_CRYPTO_TAG_SIZE; i++ )
+    {
+    frame[LORA_CRYPTO_HEADER_SIZE + number_of_bytes + i] = tag[i];
+    }
+
+/*----------------------------------------------------------
+Keystream is spent whether or not tx succeeds
+----------------------------------------------------------*/
+s_tx.ready = false;
+s_tx_counter++;
+
+sent = lora_send_message( frame, LORA_CRYPTO_HEADER_SIZE + number_of_bytes + LORA_CRYPTO_TAG_SIZE );
+
+lora_crypto_precompute();
+
+return sent;
+
+} /* lora_crypto_send_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_get_message
+*
+*   DESCRIPTION:
+*       lora_get_message() with authentication and decryption.
+*       A bad tag or replayed counter returns true with
+*       RX_KEY_ERR and no data.
+*
+*********************************************************************/
+bool lora_crypto_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t  frame[CRYPTO_FRAME_SIZE];      /* received frame */
+uint8_t  frame_size;                    /* frame size     */
+uint8_t  tag[POLY_BLOCK_SIZE];          /* computed tag   */
+uint8_t  payload_size;                  /* ciphertext     */
+uint8_t  sender;                        /* sender id      */
+uint32_t counter;                       /* frame counter  */
+uint8_t  difference;                    /* tag mismatch   */
+int i;                                  /* interator      */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+frame_size = 0;
+difference = 0;
+
+if( !lora_get_message( frame, sizeof( frame ), &frame_size, error ) )
+    {
+    *size = 0;
+    return false;
+    }
+
+*size = 0;
+
+if( *error != RX_NO_ERROR )
+    {
+    return true;
+    }
+
+/*----------------------------------------------------------
+Verify frame holds header and tag and is not a replay
+----------------------------------------------------------*/
+if( frame_size < LORA_CRYPTO_HEADER_SIZE + LORA_CRYPTO_TAG_SIZE )
+    {
+    *error = RX_KEY_ERR;
+    return true;
+    }
+
+payload_size = frame_size - LORA_CRYPTO_HEADER_SIZE - LORA_CRYPTO_TAG_SIZE;
+sender       = frame[0];
+counter      = LOAD32_LE( &frame[1] );
+
+if( !crypto_check_replay( sender, counter ) )
+    {
+    *error = RX_KEY_ERR;
+    return true;
+    }
+
+/*----------------------------------------------------------
+Use precomputed keystream if the guess was right
+----------------------------------------------------------*/
+if( !s_rx.ready || s_rx.sender != sender || s_rx.counter != counter )
+    {
+    crypto_generate( &s_rx, sender, counter );
+    }
+
+/*----------------------------------------------------------
+Compare tag in constant time
+----------------------------------------------------------*/
+crypto_tag( &s_rx, frame, payload_size, tag );
+
+for( i = 0; i < LORA_CRYPTO_TAG_SIZE; i++ )
+    {
+    difference |= tag[i] ^ frame[LORA_CRYPTO_HEADER_SIZE + payload_size + i];
+    }
+
+if( difference != 0 )
+    {
+    *error = RX_KEY_ERR;
+    return true;
+    }
+
+/*----------------------------------------------------------
+Verify message[] can fit message received
+----------------------------------------------------------*/
+if( payload_size > size_of_message )
+    {
+    *error = RX_ARRAY_SIZE_ERR;
+    }
+else
+    {
+    for( i = 0; i < payload_size; i++ )
+        {
+        message[i] = frame[LORA_CRYPTO_HEADER_SIZE + i] ^ s_rx.stream[i];
+        }
+    *size = payload_size;
+    }
+
+/*----------------------------------------------------------
+Accept counter and guess the next frame from this sender
+----------------------------------------------------------*/
+crypto_accept_counter( sender, counter );
+
+s_rx.ready    = false;
+s_rx_expected = true;
+s_rx_sender   = sender;
+s_rx_counter  = counter + 1;
+
+return true;
+
+} /* lora_crypto_get_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_crypto_run_benchmark
+*
+*   DESCRIPTION:
+*       measures cycles per byte with the DWT cycle counter for
+*       a LORA_CRYPTO_MAX_PAYLOAD frame: keystream generation,
+*       and the send path cost (xor + tag) once the keystream
+*       is precomputed. Target only, uses a scratch keystream so
+*       tx / rx state is untouched.
+*
+*********************************************************************/
+void lora_crypto_run_benchmark
+    (
+    lora_crypto_benchmark *result         /* measured cost          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+crypto_keystream scratch;               /* benchmark stream */
+uint8_t  frame[CRYPTO_FRAME_SIZE];      /* benchmark frame  */
+uint8_t  tag[POLY_BLOCK_SIZE];          /* benchmark tag    */
+uint32_t start;                         /* cycle count      */
+int i;                                  /* interator        */
+
+/*----------------------------------------------------------
+Enable cycle counter
+----------------------------------------------------------*/
+DEMCR_R     |= DEMCR_TRCENA;
+DWT_CYCCNT_R = 0;
+DWT_CTRL_R  |= DWT_CYCCNTENA;
+
+for( i = 0; i < CRYPTO_FRAME_SIZE; i++ )
+    {
+    frame[i] = (uint8_t)i;
+    }
+
+/*----------------------------------------------------------
+Keystream generation, done during idle time
+----------------------------------------------------------*/
+start = DWT_CYCCNT_R;
+crypto_generate( &scratch, s_node_id, 0 );
+result->keystream_cpb = ( DWT_CYCCNT_R - start ) / LORA_CRYPTO_MAX_PAYLOAD;
+
+/*----------------------------------------------------------
+Send path with keystream ready
+----------------------------------------------------------*/
+start = DWT_CYCCNT_R;
+for( i = 0; i < LORA_CRYPTO_MAX_PAYLOAD; i++ )
+    {
+    frame[LORA_CRYPTO_HEADER_SIZE + i] ^= scratch.stream[i];
+    }
+crypto_tag( &scratch, frame, LORA_CRYPTO_MAX_PAYLOAD, tag );
+result->send_path_cpb = ( DWT_CYCCNT_R - start ) / LORA_CRYPTO_MAX_PAYLOAD;
+
+} /* lora_crypto_run_benchmark() */
@@ -0,0 +1,116 @@
+/*********************************************************************
+*
+*   HEADER:
+*       header file for loraCrypto
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+#ifndef LORA_CRYPTO_H
+#define LORA_CRYPTO_H
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define LORA_CRYPTO_KEY_SIZE    ( 32 )     /* ChaCha20 key bytes        */
+
+#define LORA_CRYPTO_HEADER_SIZE ( 5 )      /* sender id + counter       */
+
+#define LORA_CRYPTO_TAG_SIZE    ( 8 )      /* truncated Poly1305 tag    */
+
+#define LORA_CRYPTO_MAX_PAYLOAD ( 128 )    /* largest plaintext         */
+
+#define LORA_CRYPTO_SENDERS     ( 256 )    /* sender ids, each tracked
+                                              for replay protection     */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef struct
+    {
+    uint32_t keystream_cpb;               /* keystream generation
+                                             cycles per byte        */
+    uint32_t send_path_cpb;               /* encrypt + tag cycles
+                                             per byte, keystream
+                                             precomputed            */
+    } lora_crypto_benchmark;              /* cipher cost on target  */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+loraCrypto.c
+--------------------------------------------------------------------*/
+void lora_crypto_init
+    (
+    uint8_t  key[],                       /* shared network key     */
+    uint8_t  node_id,                     /* unique id of this node */
+    uint32_t tx_counter                   /* first tx frame counter,
+                                             0 only for a new key   */
+    );
+
+uint32_t lora_crypto_get_tx_counter
+    (
+    void
+    );
+
+uint32_t lora_crypto_get_rx_counter
+    (
+    uint8_t sender                        /* sender id              */
+    );
+
+void lora_crypto_set_rx_counter
+    (
+    uint8_t  sender,                      /* sender id              */
+    uint32_t counter                      /* lowest counter still
+                                             accepted               */
+    );
+
+void lora_crypto_precompute
+    (
+    void
+    );
+
+bool lora_crypto_send_message
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    );
+
+bool lora_crypto_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    );
+
+void lora_crypto_run_benchmark
+    (
+    lora_crypto_benchmark *result         /* measured cost          */
+    );
+
+#endif /* LORA_CRYPTO_H */
+
+/* LoraCrypto.h */
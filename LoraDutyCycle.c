@@ -0,0 +1,463 @@
+/*********************************************************************
+*
+*   NAME:
+*       loraDutyCycle.c
+*
+*   DESCRIPTION:
+*       Regulatory duty cycle limiter for the LoRa API. Airtime
+*       sent on each sub-band is logged in bins of
+*       LORA_DC_WINDOW_MS / LORA_DC_WINDOW_BINS, and a frame is
+*       let out only if it fits the budget together with every
+*       bin that could hold airtime from the last observation
+*       period. Two extra bins are summed so a window starting
+*       mid bin, or a frame ending in the window after starting
+*       before it, is never missed.
+*
+*       lora_dc_init() installs the limiter as the driver tx
+*       gate, so every frame from every layer is charged its
+*       time on air. Frames over budget fail lora_transmit()
+*       until lora_dc_time_until_tx() reaches 0. While hopping,
+*       every hop channel must lie in one sub-band.
+*
+*       Time comes from the driver time source, which must be
+*       set with lora_set_time_source(). Gaps over one wrap of
+*       the microsecond count are undercounted, which only ever
+*       delays frames.
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+#include "LoraDutyCycle.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define DC_BIN_US               ( ( LORA_DC_WINDOW_MS / LORA_DC_WINDOW_BINS ) * 1000UL )
+                                           /* length of a log bin       */
+
+#define DC_RING_BINS            ( LORA_DC_WINDOW_BINS + 2 )
+                                           /* bins summed per sub-band  */
+
+#define DC_EU868_BANDS          ( 6 )      /* EU868 default sub-bands   */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+static const lora_sub_band s_eu868_bands[DC_EU868_BANDS] =
+                                           /* ETSI EN 300 220 sub-bands */
+    {
+    { 863000000, 865000000, 10   },        /* 0.1%                      */
+    { 865000000, 868000000, 100  },        /* 1%                        */
+    { 868000000, 868600000, 100  },        /* 1%  (g1)                  */
+    { 868700000, 869200000, 10   },        /* 0.1% (g2)                 */
+    { 869400000, 869650000, 1000 },        /* 10% (g3)                  */
+    { 869700000, 870000000, 100  }         /* 1%  (g4)                  */
+    };
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+static lora_sub_band s_bands[LORA_DC_MAX_SUB_BANDS]; /* sub-bands    */
+static uint32_t s_airtime_us[LORA_DC_MAX_SUB_BANDS][DC_RING_BINS];
+                                           /* airtime sent per bin      */
+static uint8_t  s_band_count      = 0;     /* sub-bands in use          */
+static uint8_t  s_bin             = 0;     /* current bin in ring       */
+static uint32_t s_bin_us          = 0;     /* time into current bin     */
+static uint32_t s_last_us         = 0;     /* time of last advance      */
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+#define DC_BUDGET_US( band )    ( ( (uint64_t)LORA_DC_WINDOW_MS * s_bands[band].duty_bp ) / 10 )
+                                           /* airtime allowed per
+                                              observation period        */
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+static void dc_advance
+    (
+    void
+    );
+
+static bool dc_find_band
+    (
+    uint8_t *band                         /* returned band index    */
+    );
+
+static uint32_t dc_wait_us
+    (
+    uint8_t  band,                        /* sub-band index         */
+    uint32_t airtime_us                   /* frame time on air      */
+    );
+
+static bool dc_tx_gate
+    (
+    uint8_t number_of_bytes               /* payload size           */
+    );
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       dc_advance
+*
+*   DESCRIPTION:
+*       moves the log to the current time, clearing bins that
+*       left the observation period
+*
+*********************************************************************/
+static void dc_advance
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t now_us;                /* current time           */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+now_us     = lora_get_time_us();
+s_bin_us  += now_us - s_last_us;
+s_last_us  = now_us;
+
+while( s_bin_us >= DC_BIN_US )
+    {
+    s_bin_us -= DC_BIN_US;
+    s_bin     = ( s_bin + 1 ) % DC_RING_BINS;
+
+    for( i = 0; i < s_band_count; i++ )
+        {
+        s_airtime_us[i][s_bin] = 0;
+        }
+    }
+
+} /* dc_advance() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       dc_find_band
+*
+*   DESCRIPTION:
+*       finds sub-band holding the current frequency, or every
+*       hop channel while hopping. Fails if the hop table spans
+*       more than one sub-band.
+*
+*********************************************************************/
+static bool dc_find_band
+    (
+    uint8_t *band                         /* returned band index    */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t frequency_hz;          /* frequency checked      */
+uint8_t  channel;               /* hop channel checked    */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+frequency_hz = lora_get_frequency();
+channel      = 0;
+
+for( i = 0; i < s_band_count; i++ )
+    {
+    if( frequency_hz >= s_bands[i].min_hz && frequency_hz < s_bands[i].max_hz )
+        {
+        break;
+        }
+    }
+
+if( i == s_band_count )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Every hop channel must share the band of the first
+----------------------------------------------------------*/
+while( lora_get_hop_frequency( channel, &frequency_hz ) )
+    {
+    if( frequency_hz < s_bands[i].min_hz || frequency_hz >= s_bands[i].max_hz )
+        {
+        return false;
+        }
+    channel++;
+    }
+
+*band = i;
+return true;
+
+} /* dc_find_band() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       dc_wait_us
+*
+*   DESCRIPTION:
+*       returns time until a frame fits the budget of a sub-band
+*       as old bins leave the log, 0 if it fits now
+*
+*********************************************************************/
+static uint32_t dc_wait_us
+    (
+    uint8_t  band,                        /* sub-band index         */
+    uint32_t airtime_us                   /* frame time on air      */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint64_t used_us;               /* airtime in the log     */
+uint32_t wait_us;               /* time until next clear  */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+used_us = 0;
+wait_us = DC_BIN_US - s_bin_us;
+
+for( i = 0; i < DC_RING_BINS; i++ )
+    {
+    used_us += s_airtime_us[band][i];
+    }
+
+if( used_us + airtime_us <= DC_BUDGET_US( band ) )
+    {
+    return 0;
+    }
+
+/*----------------------------------------------------------
+Oldest bin is the one after the current, it clears on the
+next bin boundary
+----------------------------------------------------------*/
+for( i = 1; i <= DC_RING_BINS; i++ )
+    {
+    used_us -= s_airtime_us[band][( s_bin + i ) % DC_RING_BINS];
+
+    if( used_us + airtime_us <= DC_BUDGET_US( band ) )
+        {
+        break;
+        }
+
+    wait_us += DC_BIN_US;
+    }
+
+return wait_us;
+
+} /* dc_wait_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       dc_tx_gate
+*
+*   DESCRIPTION:
+*       driver tx gate, logs the airtime of frames that fit the
+*       budget and refuses the rest
+*
+*********************************************************************/
+static bool dc_tx_gate
+    (
+    uint8_t number_of_bytes               /* payload size           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t airtime_us;            /* frame time on air      */
+uint8_t  band;                  /* current sub-band       */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+airtime_us = lora_get_time_on_air_us( number_of_bytes );
+band       = 0;
+
+dc_advance();
+
+if( !dc_find_band( &band )                    ||
+    airtime_us > DC_BUDGET_US( band )         ||
+    dc_wait_us( band, airtime_us ) != 0       )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Charge airtime, it is spent even if tx reports an error
+----------------------------------------------------------*/
+s_airtime_us[band][s_bin] += airtime_us;
+
+return true;
+
+} /* dc_tx_gate() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_dc_init
+*
+*   DESCRIPTION:
+*       sets sub-bands with an empty log and installs the
+*       limiter as the driver tx gate
+*
+*********************************************************************/
+bool lora_dc_init
+    (
+    lora_sub_band bands[],                /* sub-bands, NULL for
+                                             EU868 defaults         */
+    uint8_t       number_of_bands         /* size of array          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+int i;                          /* interator              */
+int j;                          /* interator              */
+
+/*----------------------------------------------------------
+Default to EU868
+----------------------------------------------------------*/
+if( bands == NULL )
+    {
+    bands           = (lora_sub_band *)s_eu868_bands;
+    number_of_bands = DC_EU868_BANDS;
+    }
+
+if( number_of_bands > LORA_DC_MAX_SUB_BANDS )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Store bands with nothing sent yet
+----------------------------------------------------------*/
+s_band_count = number_of_bands;
+
+for( i = 0; i < s_band_count; i++ )
+    {
+    s_bands[i] = bands[i];
+
+    for( j = 0; j < DC_RING_BINS; j++ )
+        {
+        s_airtime_us[i][j] = 0;
+        }
+    }
+
+s_bin     = 0;
+s_bin_us  = 0;
+s_last_us = lora_get_time_us();
+
+lora_set_tx_gate( dc_tx_gate );
+
+return true;
+
+} /* lora_dc_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_dc_time_until_tx
+*
+*   DESCRIPTION:
+*       returns ms until a frame of number_of_bytes fits the
+*       budget of the current sub-band, 0 if it can be sent now
+*       and LORA_DC_NEVER if it never can
+*
+*********************************************************************/
+uint32_t lora_dc_time_until_tx
+    (
+    uint8_t  number_of_bytes              /* payload size           */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t airtime_us;            /* frame time on air      */
+uint8_t  band;                  /* current sub-band       */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+airtime_us = lora_get_time_on_air_us( number_of_bytes );
+band       = 0;
+
+if( !dc_find_band( &band ) ||
+    airtime_us > DC_BUDGET_US( band ) )
+    {
+    return LORA_DC_NEVER;
+    }
+
+dc_advance();
+
+return ( dc_wait_us( band, airtime_us ) + 999 ) / 1000;
+
+} /* lora_dc_time_until_tx() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_dc_send_message
+*
+*   DESCRIPTION:
+*       lora_send_message() with the duty cycle result. Frames
+*       that do not fit yet are deferred, call
+*       lora_dc_time_until_tx() for when to retry.
+*
+*********************************************************************/
+lora_dc_status lora_dc_send_message
+    (
+    uint8_t  Message[],                   /* array of bytes to send */
+    uint8_t  number_of_bytes              /* size of array          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t wait_ms;               /* time until budget fits */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+wait_ms = lora_dc_time_until_tx( number_of_bytes );
+
+if( wait_ms == LORA_DC_NEVER )
+    {
+    return DC_REJECTED;
+    }
+else if( wait_ms != 0 )
+    {
+    return DC_DEFERRED;
+    }
+
+/*----------------------------------------------------------
+Tx gate charges the airtime
+----------------------------------------------------------*/
+if( !lora_send_message( Message, number_of_bytes ) )
+    {
+    return DC_TX_ERROR;
+    }
+
+return DC_SENT;
+
+} /* lora_dc_send_message() */
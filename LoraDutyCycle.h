@@ -0,0 +1,94 @@
+/*********************************************************************
+*
+*   HEADER:
+*       header file for loraDutyCycle
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+#ifndef LORA_DUTY_CYCLE_H
+#define LORA_DUTY_CYCLE_H
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define LORA_DC_MAX_SUB_BANDS   ( 8 )      /* sub-bands tracked         */
+
+#define LORA_DC_WINDOW_MS       ( 3600000UL )
+                                           /* duty cycle observation
+                                              period, 1 hour            */
+
+#define LORA_DC_WINDOW_BINS     ( 60 )     /* airtime log bins per
+                                              observation period        */
+
+#define LORA_DC_NEVER           ( 0xFFFFFFFFUL )
+                                           /* frame can never be sent   */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef uint8_t lora_dc_status;        /* duty cycle send result    */
+enum
+    {
+    DC_SENT,                          /* frame sent                 */
+    DC_DEFERRED,                      /* budget short, retry later  */
+    DC_REJECTED,                      /* frequency not in a sub-band
+                                         or frame exceeds budget    */
+    DC_TX_ERROR                       /* lora_send_message() failed */
+    };
+
+typedef struct
+    {
+    uint32_t min_hz;                      /* sub-band start (Hz)    */
+    uint32_t max_hz;                      /* sub-band end (Hz)      */
+    uint16_t duty_bp;                     /* duty cycle in 0.01%    */
+    } lora_sub_band;                      /* regulatory sub-band    */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+loraDutyCycle.c
+--------------------------------------------------------------------*/
+bool lora_dc_init
+    (
+    lora_sub_band bands[],                /* sub-bands, NULL for
+                                             EU868 defaults         */
+    uint8_t       number_of_bands         /* size of array          */
+    );
+
+uint32_t lora_dc_time_until_tx
+    (
+    uint8_t  number_of_bytes              /* payload size           */
+    );
+
+lora_dc_status lora_dc_send_message
+    (
+    uint8_t  Message[],                   /* array of bytes to send */
+    uint8_t  number_of_bytes              /* size of array          */
+    );
+
+#endif /* LORA_DUTY_CYCLE_H */
+
+/* LoraDutyCycle.h */
@@ -0,0 +1,753 @@
+/*********************************************************************
+*
+*   NAME:
+*       loraFrag.c
+*
+*   DESCRIPTION:
+*       Fragmentation and reassembly for buffers larger than one
+*       LoRa frame. The sender streams every fragment back to
+*       back, the receiver reassembles into a fixed buffer and
+*       tracks received fragments in a bitmap. The receiver can
+*       re-request just the missing fragments, and reports an
+*       empty missing bitmap once the transfer is complete. If
+*       the sender hears nothing it queries the receiver, which
+*       answers with its missing bitmap.
+*
+*       Transfers are keyed by a session set in lora_frag_init()
+*       plus a transfer id, so ids restarting after a reboot are
+*       not mistaken for the peer's last transfer. The session
+*       must differ every boot, e.g. a boot counter kept in
+*       EEPROM.
+*
+*       Data frame layout:
+*           byte 0  - frame type
+*           byte 1  - session
+*           byte 2  - transfer id
+*           byte 3  - fragment index
+*           byte 4  - fragment count
+*           byte 5+ - LORA_FRAG_PAYLOAD_SIZE bytes, fewer in the
+*                     last fragment
+*
+*       Request frame layout:
+*           byte 0   - frame type
+*           byte 1   - session
+*           byte 2   - transfer id
+*           byte 3-6 - missing fragment bitmap, LSB first
+*
+*       Query frame layout:
+*           byte 0   - frame type
+*           byte 1   - session
+*           byte 2   - transfer id
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+#include "LoraFrag.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define FRAG_HEADER_SIZE        ( 5 )      /* type, session, id, index,
+                                              count                     */
+
+#define FRAG_FRAME_SIZE         ( FRAG_HEADER_SIZE + LORA_FRAG_PAYLOAD_SIZE )
+                                           /* largest data frame        */
+
+#define FRAG_REQUEST_SIZE       ( 7 )      /* type, session, id, 4 byte
+                                              bitmap                    */
+
+#define FRAG_QUERY_SIZE         ( 3 )      /* type, session, id         */
+
+#define US_PER_MS               ( 1000 )   /* microseconds per ms       */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef uint8_t frag_frame_type;  /* fragment frame types           */
+enum
+    {
+    FRAG_FRAME_DATA    = 0xB0,    /* fragment of a transfer         */
+    FRAG_FRAME_REQUEST = 0xB1,    /* missing fragment request       */
+    FRAG_FRAME_QUERY   = 0xB2     /* sender asks for missing bitmap */
+    };
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+static bool     s_inited         = false;  /* session set T/F           */
+static uint8_t  s_session        = 0;      /* this boot's session       */
+
+static uint8_t *s_tx_buffer      = NULL;   /* transfer being sent       */
+static uint16_t s_tx_size        = 0;      /* size of transfer          */
+static uint8_t  s_tx_count       = 0;      /* fragments in transfer     */
+static uint8_t  s_tx_id          = 0;      /* id of transfer            */
+static bool     s_tx_complete    = false;  /* peer has it all T/F       */
+static uint32_t s_tx_time_ms     = 0;      /* end of last tx activity   */
+static uint32_t s_tx_timeout_ms  = 0;      /* wait before querying      */
+static uint32_t s_data_tx_ms     = 0;      /* full fragment send time   */
+static uint32_t s_query_tx_ms    = 0;      /* query send time           */
+static uint8_t  s_tx_queries     = 0;      /* unanswered queries        */
+
+static uint8_t  s_rx_buffer[LORA_FRAG_MAX_TRANSFER];
+                                           /* reassembly buffer         */
+static bool     s_rx_active      = false;  /* transfer started T/F      */
+static uint8_t  s_rx_session     = 0;      /* session of transfer       */
+static uint8_t  s_rx_id          = 0;      /* id of transfer            */
+static uint8_t  s_rx_count       = 0;      /* fragments in transfer     */
+static uint32_t s_rx_received    = 0;      /* received fragment bitmap  */
+static uint16_t s_rx_size        = 0;      /* reassembled size          */
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+#define FRAG_ALL_MASK( count )  ( ( count ) >= 32 ? 0xFFFFFFFFUL : ( ( 1UL << ( count ) ) - 1 ) )
+                                           /* bitmap with count bits    */
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+static bool frag_send_fragment
+    (
+    uint8_t index                         /* fragment index         */
+    );
+
+static bool frag_send_request
+    (
+    uint8_t  session,                     /* transfer session       */
+    uint8_t  id,                          /* transfer id            */
+    uint32_t missing                      /* missing bitmap         */
+    );
+
+static bool frag_send_query
+    (
+    void
+    );
+
+static void frag_process_data
+    (
+    uint8_t frame[],                      /* received frame         */
+    uint8_t size                          /* frame size             */
+    );
+
+static void frag_process_request
+    (
+    uint8_t  frame[],                     /* received frame         */
+    uint32_t current_time_ms              /* current time in ms     */
+    );
+
+static void frag_process_query
+    (
+    uint8_t frame[]                       /* received frame         */
+    );
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       frag_send_fragment
+*
+*   DESCRIPTION:
+*       sends one fragment of the current transfer
+*
+*********************************************************************/
+static bool frag_send_fragment
+    (
+    uint8_t index                         /* fragment index         */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t  frame[FRAG_FRAME_SIZE]; /* frame to send         */
+uint16_t offset;                 /* offset into transfer  */
+uint8_t  length;                 /* payload bytes         */
+int i;                           /* interator             */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+offset = (uint16_t)index * LORA_FRAG_PAYLOAD_SIZE;
+length = ( s_tx_size - offset > LORA_FRAG_PAYLOAD_SIZE ) ?
+         LORA_FRAG_PAYLOAD_SIZE : (uint8_t)( s_tx_size - offset );
+
+/*----------------------------------------------------------
+Build and send frame
+----------------------------------------------------------*/
+frame[0] = FRAG_FRAME_DATA;
+frame[1] = s_session;
+frame[2] = s_tx_id;
+frame[3] = index;
+frame[4] = s_tx_count;
+
+for( i = 0; i < length; i++ )
+    {
+    frame[FRAG_HEADER_SIZE + i] = s_tx_buffer[offset + i];
+    }
+
+return lora_send_message( frame, FRAG_HEADER_SIZE + length );
+
+} /* frag_send_fragment() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       frag_send_request
+*
+*   DESCRIPTION:
+*       sends missing fragment bitmap and returns to continious
+*       rx
+*
+*********************************************************************/
+static bool frag_send_request
+    (
+    uint8_t  session,                     /* transfer session       */
+    uint8_t  id,                          /* transfer id            */
+    uint32_t missing                      /* missing bitmap         */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t frame[FRAG_REQUEST_SIZE]; /* frame to send        */
+bool    sent;                     /* tx result            */
+
+/*----------------------------------------------------------
+Build and send frame
+----------------------------------------------------------*/
+frame[0] = FRAG_FRAME_REQUEST;
+frame[1] = session;
+frame[2] = id;
+frame[3] = (uint8_t)( missing );
+frame[4] = (uint8_t)( missing >> 8 );
+frame[5] = (uint8_t)( missing >> 16 );
+frame[6] = (uint8_t)( missing >> 24 );
+
+sent = lora_send_message( frame, FRAG_REQUEST_SIZE );
+
+if( !lora_init_continious_rx() )
+    {
+    return false;
+    }
+
+return sent;
+
+} /* frag_send_request() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       frag_send_query
+*
+*   DESCRIPTION:
+*       asks the receiver for its missing bitmap of the current
+*       transfer and returns to continious rx
+*
+*********************************************************************/
+static bool frag_send_query
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t frame[FRAG_QUERY_SIZE];   /* frame to send        */
+bool    sent;                     /* tx result            */
+
+/*----------------------------------------------------------
+Build and send frame
+----------------------------------------------------------*/
+frame[0] = FRAG_FRAME_QUERY;
+frame[1] = s_session;
+frame[2] = s_tx_id;
+
+sent = lora_send_message( frame, FRAG_QUERY_SIZE );
+
+if( !lora_init_continious_rx() )
+    {
+    return false;
+    }
+
+return sent;
+
+} /* frag_send_query() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       frag_process_data
+*
+*   DESCRIPTION:
+*       stores a fragment in the reassembly buffer. A fragment
+*       with a new session or transfer id restarts reassembly.
+*
+*********************************************************************/
+static void frag_process_data
+    (
+    uint8_t frame[],                      /* received frame         */
+    uint8_t size                          /* frame size             */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t  session;               /* transfer session       */
+uint8_t  id;                    /* transfer id            */
+uint8_t  index;                 /* fragment index         */
+uint8_t  count;                 /* fragment count         */
+uint8_t  length;                /* payload bytes          */
+uint16_t offset;                /* offset into buffer     */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+session = frame[1];
+id      = frame[2];
+index   = frame[3];
+count   = frame[4];
+length  = size - FRAG_HEADER_SIZE;
+offset  = (uint16_t)index * LORA_FRAG_PAYLOAD_SIZE;
+
+/*----------------------------------------------------------
+Verify header, only the last fragment may be short
+----------------------------------------------------------*/
+if( count == 0 || count > LORA_FRAG_MAX_FRAGMENTS || index >= count ||
+    length == 0 || length > LORA_FRAG_PAYLOAD_SIZE                  ||
+    ( index != count - 1 && length != LORA_FRAG_PAYLOAD_SIZE )      )
+    {
+    return;
+    }
+
+/*----------------------------------------------------------
+Start new transfer
+----------------------------------------------------------*/
+if( !s_rx_active || session != s_rx_session || id != s_rx_id )
+    {
+    s_rx_active   = true;
+    s_rx_session  = session;
+    s_rx_id       = id;
+    s_rx_count    = count;
+    s_rx_received = 0;
+    s_rx_size     = 0;
+    }
+
+if( count != s_rx_count )
+    {
+    return;
+    }
+
+/*----------------------------------------------------------
+Store fragment, duplicates of a finished transfer mean the
+sender missed the completion report
+----------------------------------------------------------*/
+if( ( s_rx_received & ( 1UL << index ) ) == 0 )
+    {
+    for( i = 0; i < length; i++ )
+        {
+        s_rx_buffer[offset + i] = frame[FRAG_HEADER_SIZE + i];
+        }
+    s_rx_received |= ( 1UL << index );
+
+    if( index == count - 1 )
+        {
+        s_rx_size = offset + length;
+        }
+    }
+else if( s_rx_received != FRAG_ALL_MASK( s_rx_count ) )
+    {
+    return;
+    }
+
+/*----------------------------------------------------------
+Report completion
+----------------------------------------------------------*/
+if( s_rx_received == FRAG_ALL_MASK( s_rx_count ) )
+    {
+    frag_send_request( s_rx_session, s_rx_id, 0 );
+    }
+
+} /* frag_process_data() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       frag_process_request
+*
+*   DESCRIPTION:
+*       resends fragments the peer reports missing, an empty
+*       bitmap completes the transfer. The quiet timer starts
+*       at the end of the resent stream, as sending blocks.
+*
+*********************************************************************/
+static void frag_process_request
+    (
+    uint8_t  frame[],                     /* received frame         */
+    uint32_t current_time_ms              /* current time in ms     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t missing;               /* missing bitmap         */
+uint8_t  resent;                /* fragments resent       */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Ignore requests for other transfers
+----------------------------------------------------------*/
+if( s_tx_buffer == NULL || s_tx_complete ||
+    frame[1] != s_session || frame[2] != s_tx_id )
+    {
+    return;
+    }
+
+missing = (uint32_t)frame[3]         |
+          ( (uint32_t)frame[4] << 8  ) |
+          ( (uint32_t)frame[5] << 16 ) |
+          ( (uint32_t)frame[6] << 24 );
+missing &= FRAG_ALL_MASK( s_tx_count );
+
+s_tx_queries = 0;
+s_tx_time_ms = current_time_ms;
+resent       = 0;
+
+if( missing == 0 )
+    {
+    s_tx_complete = true;
+    return;
+    }
+
+/*----------------------------------------------------------
+Stream missing fragments back to back
+----------------------------------------------------------*/
+for( i = 0; i < s_tx_count; i++ )
+    {
+    if( ( missing & ( 1UL << i ) ) != 0 )
+        {
+        frag_send_fragment( i );
+        resent++;
+        }
+    }
+s_tx_time_ms += resent * s_data_tx_ms;
+
+lora_init_continious_rx();
+
+} /* frag_process_request() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       frag_process_query
+*
+*   DESCRIPTION:
+*       answers a sender query with the missing bitmap. A
+*       transfer not heard at all is reported fully missing.
+*
+*********************************************************************/
+static void frag_process_query
+    (
+    uint8_t frame[]                       /* received frame         */
+    )
+{
+if( s_rx_active && frame[1] == s_rx_session && frame[2] == s_rx_id )
+    {
+    frag_send_request( s_rx_session, s_rx_id, lora_frag_missing() );
+    }
+else
+    {
+    frag_send_request( frame[1], frame[2], 0xFFFFFFFFUL );
+    }
+
+} /* frag_process_query() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_init
+*
+*   DESCRIPTION:
+*       sets the session for this boot and derives the query
+*       timeout from the driver send time, time on air plus mode
+*       switches, at the current modem settings.
+*       session must not repeat across reboots. Call after the
+*       modem is configured, lora_frag_send() fails until then.
+*
+*********************************************************************/
+void lora_frag_init
+    (
+    uint8_t session                       /* unique per boot        */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t request_tx_ms;         /* request send time      */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+s_data_tx_ms  = ( lora_get_send_time_us( FRAG_FRAME_SIZE ) + US_PER_MS - 1 ) / US_PER_MS;
+s_query_tx_ms = ( lora_get_send_time_us( FRAG_QUERY_SIZE ) + US_PER_MS - 1 ) / US_PER_MS;
+request_tx_ms = ( lora_get_send_time_us( FRAG_REQUEST_SIZE ) + US_PER_MS - 1 ) / US_PER_MS;
+
+/*----------------------------------------------------------
+Receiver reports as soon as the last fragment lands, allow
+for one more fragment still in the air and the report
+----------------------------------------------------------*/
+s_tx_timeout_ms = 2 * ( s_data_tx_ms + request_tx_ms );
+
+s_session     = session;
+s_tx_id       = 0;
+s_tx_buffer   = NULL;
+s_tx_complete = false;
+s_rx_active   = false;
+s_inited      = true;
+
+} /* lora_frag_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_send
+*
+*   DESCRIPTION:
+*       starts a new transfer and streams every fragment back to
+*       back, then returns to continious rx to hear requests.
+*       buffer[] must stay valid until lora_frag_tx_complete().
+*       current_time_ms is the time of the call, the quiet timer
+*       starts at the end of the stream.
+*
+*********************************************************************/
+bool lora_frag_send
+    (
+    uint8_t  buffer[],                    /* bytes to send, kept by
+                                             caller until complete  */
+    uint16_t size,                        /* size of buffer         */
+    uint32_t current_time_ms              /* current time in ms     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+bool sent;                      /* all fragments sent     */
+int i;                          /* interator              */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+sent = true;
+
+/*----------------------------------------------------------
+Verify transfer fits
+----------------------------------------------------------*/
+if( !s_inited || size == 0 || size > LORA_FRAG_MAX_TRANSFER )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Start transfer
+----------------------------------------------------------*/
+s_tx_buffer   = buffer;
+s_tx_size     = size;
+s_tx_count    = ( size + LORA_FRAG_PAYLOAD_SIZE - 1 ) / LORA_FRAG_PAYLOAD_SIZE;
+s_tx_complete = false;
+s_tx_queries  = 0;
+s_tx_id++;
+
+for( i = 0; i < s_tx_count; i++ )
+    {
+    sent &= frag_send_fragment( i );
+    }
+s_tx_time_ms = current_time_ms + ( s_tx_count * s_data_tx_ms );
+
+if( !lora_init_continious_rx() )
+    {
+    return false;
+    }
+
+return sent;
+
+} /* lora_frag_send() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_tx_complete
+*
+*   DESCRIPTION:
+*       returns true once the peer reported the whole transfer
+*       received
+*
+*********************************************************************/
+bool lora_frag_tx_complete
+    (
+    void
+    )
+{
+return s_tx_complete;
+
+} /* lora_frag_tx_complete() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_poll
+*
+*   DESCRIPTION:
+*       handles one received frame from the peer and queries
+*       the receiver when a transfer being sent has gone quiet.
+*       Call often. Returns false once LORA_FRAG_MAX_QUERIES go
+*       unanswered and the transfer is abandoned.
+*
+*********************************************************************/
+bool lora_frag_poll
+    (
+    uint32_t current_time_ms              /* current time in ms     */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t     frame[FRAG_FRAME_SIZE]; /* received frame     */
+uint8_t     frame_size;             /* received size      */
+lora_errors error;                  /* rx error           */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+frame_size = 0;
+error      = RX_NO_ERROR;
+
+/*----------------------------------------------------------
+Process received frame
+----------------------------------------------------------*/
+if( lora_get_message( frame, sizeof( frame ), &frame_size, &error ) &&
+    error == RX_NO_ERROR )
+    {
+    if( frame[0] == FRAG_FRAME_DATA && frame_size > FRAG_HEADER_SIZE )
+        {
+        frag_process_data( frame, frame_size );
+        }
+    else if( frame[0] == FRAG_FRAME_REQUEST && frame_size == FRAG_REQUEST_SIZE )
+        {
+        frag_process_request( frame, current_time_ms );
+        }
+    else if( frame[0] == FRAG_FRAME_QUERY && frame_size == FRAG_QUERY_SIZE )
+        {
+        frag_process_query( frame );
+        }
+    }
+
+/*----------------------------------------------------------
+Query receiver if the transfer has gone quiet, a lost
+completion report would otherwise leave it hanging. The
+stream end is an estimate, so compare signed in case it is
+still ahead of current_time_ms.
+----------------------------------------------------------*/
+if( s_tx_buffer == NULL || s_tx_complete ||
+    (int32_t)( current_time_ms - s_tx_time_ms ) < (int32_t)s_tx_timeout_ms )
+    {
+    return true;
+    }
+
+if( s_tx_queries >= LORA_FRAG_MAX_QUERIES )
+    {
+    s_tx_buffer = NULL;
+    return false;
+    }
+
+s_tx_queries++;
+s_tx_time_ms = current_time_ms + s_query_tx_ms;
+frag_send_query();
+
+return true;
+
+} /* lora_frag_poll() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_missing
+*
+*   DESCRIPTION:
+*       returns bitmap of fragments not yet received
+*
+*********************************************************************/
+uint32_t lora_frag_missing
+    (
+    void
+    )
+{
+if( !s_rx_active )
+    {
+    return 0;
+    }
+
+return ~s_rx_received & FRAG_ALL_MASK( s_rx_count );
+
+} /* lora_frag_missing() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_request_missing
+*
+*   DESCRIPTION:
+*       asks the sender for missing fragments. Call when the
+*       stream has gone quiet before the transfer completed.
+*
+*********************************************************************/
+bool lora_frag_request_missing
+    (
+    void
+    )
+{
+if( !s_rx_active )
+    {
+    return false;
+    }
+
+return frag_send_request( s_rx_session, s_rx_id, lora_frag_missing() );
+
+} /* lora_frag_request_missing() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_frag_get_transfer
+*
+*   DESCRIPTION:
+*       returns reassembled transfer once complete. buffer stays
+*       valid until a fragment of the next transfer arrives.
+*
+*********************************************************************/
+bool lora_frag_get_transfer
+    (
+    uint8_t  **buffer,                    /* reassembled data       */
+    uint16_t  *size                       /* size of data           */
+    )
+{
+if( !s_rx_active || lora_frag_missing() != 0 )
+    {
+    return false;
+    }
+
+*buffer = s_rx_buffer;
+*size   = s_rx_size;
+
+return true;
+
+} /* lora_frag_get_transfer() */
@@ -0,0 +1,100 @@
+/*********************************************************************
+*
+*   HEADER:
+*       header file for loraFrag
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+#ifndef LORA_FRAG_H
+#define LORA_FRAG_H
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define LORA_FRAG_PAYLOAD_SIZE  ( 96 )     /* data bytes per fragment   */
+
+#define LORA_FRAG_MAX_FRAGMENTS ( 32 )     /* fragments per transfer,
+                                              one bit each in a
+                                              uint32_t bitmap           */
+
+#define LORA_FRAG_MAX_TRANSFER  ( LORA_FRAG_PAYLOAD_SIZE * LORA_FRAG_MAX_FRAGMENTS )
+                                           /* largest transfer / size
+                                              of reassembly buffer      */
+
+#define LORA_FRAG_MAX_QUERIES   ( 8 )      /* unanswered queries before
+                                              a transfer is abandoned   */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+loraFrag.c
+--------------------------------------------------------------------*/
+void lora_frag_init
+    (
+    uint8_t session                       /* unique per boot        */
+    );
+
+bool lora_frag_send
+    (
+    uint8_t  buffer[],                    /* bytes to send, kept by
+                                             caller until complete  */
+    uint16_t size,                        /* size of buffer         */
+    uint32_t current_time_ms              /* current time in ms     */
+    );
+
+bool lora_frag_tx_complete
+    (
+    void
+    );
+
+bool lora_frag_poll
+    (
+    uint32_t current_time_ms              /* current time in ms     */
+    );
+
+uint32_t lora_frag_missing
+    (
+    void
+    );
+
+bool lora_frag_request_missing
+    (
+    void
+    );
+
+bool lora_frag_get_transfer
+    (
+    uint8_t  **buffer,                    /* reassembled data       */
+    uint16_t  *size                       /* size of data           */
+    );
+
+#endif /* LORA_FRAG_H */
+
+/* LoraFrag.h */
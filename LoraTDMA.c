@@ -0,0 +1,683 @@
+/*********************************************************************
+*
+*   NAME:
+*       loraTDMA.c
+*
+*   DESCRIPTION:
+*       TDMA access for the LoRa API. The gateway sends a beacon
+*       at the start of every frame, followed by one slot per
+*       node. Slot and guard lengths come from the time on air
+*       of the beacon and of the largest slot frame, with the
+*       guard covering turnaround plus clock drift of both ends
+*       over the LORA_TDMA_MAX_MISSED_BEACONS + 1 frames a node
+*       may send without a beacon. Nodes align to the RxDone
+*       timestamp of the beacon and start their packet at the
+*       slot start.
+*
+*       A time source must be set with lora_set_time_source(),
+*       and lora_dio0_isr() should be called from the DIO0
+*       interrupt for accurate timestamps.
+*
+*       Sends block until their start time with the radio out
+*       of rx, and in continious rx only the last packet is
+*       kept. Poll lora_tdma_get_message() until
+*       lora_tdma_time_until_tx_us() returns 0 and only then
+*       send, so the block only covers the fifo load and no slot
+*       packet is lost.
+*
+*       The gateway counts node slots offered and slots a packet
+*       arrived in for channel utilisation, and packets that are
+*       corrupt, outside a slot or in a slot already used that
+*       frame as collisions.
+*
+*       Beacon layout:
+*           byte 0    - frame type
+*           byte 1    - frame number
+*           byte 2    - slot count
+*           byte 3    - max payload per slot
+*           byte 4-7  - first slot offset from frame start (us)
+*           byte 8-11 - slot length (us)
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+#include "LoraTDMA.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define TDMA_BEACON_TYPE        ( 0xC0 )   /* beacon frame type         */
+
+#define TDMA_BEACON_SIZE        ( 12 )     /* beacon frame size         */
+
+#define PPM_SCALE               ( 1000000UL )
+                                           /* parts per million         */
+
+#define TDMA_LOAD_MARGIN_US     ( 2000 )   /* fifo fill allowance on
+                                              top of the mode delay     */
+
+#define TDMA_MAX_SLOTS          ( 256 )    /* slot count range          */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+static bool     s_is_gateway        = false; /* gateway role T/F        */
+static bool     s_synced            = false; /* frame start known T/F   */
+static uint8_t  s_slot              = 0;     /* node slot               */
+static uint8_t  s_slot_count        = 0;     /* node slots per frame    */
+static uint8_t  s_max_payload       = 0;     /* largest slot frame      */
+static uint8_t  s_frame_number      = 0;     /* beacon counter          */
+static uint32_t s_first_slot_us     = 0;     /* beacon slot length      */
+static uint32_t s_slot_us           = 0;     /* node slot length        */
+static uint32_t s_frame_start_us    = 0;     /* start of last frame     */
+static uint8_t  s_slot_used[TDMA_MAX_SLOTS / 8];
+                                             /* slots heard this frame  */
+static lora_tdma_stats s_stats;              /* TDMA counters           */
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+#define TDMA_BEFORE( a, b )     ( (int32_t)( ( a ) - ( b ) ) < 0 )
+                                           /* time a earlier than b,
+                                              safe across wrap          */
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+static bool tdma_next_start
+    (
+    uint32_t  offset_us,                  /* offset into frame      */
+    uint32_t *start_us                    /* returned start time    */
+    );
+
+static void tdma_wait_until
+    (
+    uint32_t start_us                     /* time to wait for       */
+    );
+
+static void tdma_process_beacon
+    (
+    uint8_t beacon[]                      /* received beacon        */
+    );
+
+static void tdma_record_slot
+    (
+    uint8_t number_of_bytes               /* received payload size  */
+    );
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       tdma_next_start
+*
+*   DESCRIPTION:
+*       returns the next time offset_us into a frame that has
+*       not passed. Fails once the last beacon is more than
+*       LORA_TDMA_MAX_MISSED_BEACONS frames old.
+*
+*********************************************************************/
+static bool tdma_next_start
+    (
+    uint32_t  offset_us,                  /* offset into frame      */
+    uint32_t *start_us                    /* returned start time    */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t now_us;                /* current time           */
+uint32_t frame_us;              /* frame length           */
+uint8_t  frames_ahead;          /* frames past beacon     */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+now_us       = lora_get_time_us();
+frame_us     = lora_tdma_frame_length_us();
+frames_ahead = 0;
+*start_us    = s_frame_start_us + offset_us;
+
+/*----------------------------------------------------------
+Step forward a frame at a time
+----------------------------------------------------------*/
+while( TDMA_BEFORE( *start_us, now_us ) )
+    {
+    *start_us += frame_us;
+    frames_ahead++;
+
+    if( frames_ahead > LORA_TDMA_MAX_MISSED_BEACONS )
+        {
+        return false;
+        }
+    }
+
+return true;
+
+} /* tdma_next_start() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       tdma_wait_until
+*
+*   DESCRIPTION:
+*       busy waits until start_us
+*
+*********************************************************************/
+static void tdma_wait_until
+    (
+    uint32_t start_us                     /* time to wait for       */
+    )
+{
+while( TDMA_BEFORE( lora_get_time_us(), start_us ) )
+    {
+    }
+
+} /* tdma_wait_until() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       tdma_process_beacon
+*
+*   DESCRIPTION:
+*       takes schedule from a beacon and sets frame start to
+*       the beacon RxDone time less its time on air
+*
+*********************************************************************/
+static void tdma_process_beacon
+    (
+    uint8_t beacon[]                      /* received beacon        */
+    )
+{
+s_frame_number   = beacon[1];
+s_slot_count     = beacon[2];
+s_max_payload    = beacon[3];
+s_first_slot_us  = (uint32_t)beacon[4]          |
+                   ( (uint32_t)beacon[5] << 8 )  |
+                   ( (uint32_t)beacon[6] << 16 ) |
+                   ( (uint32_t)beacon[7] << 24 );
+s_slot_us        = (uint32_t)beacon[8]          |
+                   ( (uint32_t)beacon[9] << 8 )  |
+                   ( (uint32_t)beacon[10] << 16 ) |
+                   ( (uint32_t)beacon[11] << 24 );
+s_frame_start_us = lora_get_rx_done_time() - lora_get_time_on_air_us( TDMA_BEACON_SIZE );
+s_synced         = true;
+
+s_stats.beacons_received++;
+
+} /* tdma_process_beacon() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       tdma_record_slot
+*
+*   DESCRIPTION:
+*       finds the slot a received packet started in from its
+*       RxDone time. Marks the slot used, or counts a collision
+*       if the packet is outside every slot or the slot was
+*       already used this frame.
+*
+*********************************************************************/
+static void tdma_record_slot
+    (
+    uint8_t number_of_bytes               /* received payload size  */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t offset_us;             /* packet start in frame  */
+uint32_t slot;                  /* slot packet started in */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+offset_us = lora_get_rx_done_time() - lora_get_time_on_air_us( number_of_bytes ) -
+            s_frame_start_us;
+
+if( !s_synced                                       ||
+    offset_us < s_first_slot_us                     ||
+    offset_us >= lora_tdma_frame_length_us()        )
+    {
+    s_stats.collisions++;
+    return;
+    }
+
+slot = ( offset_us - s_first_slot_us ) / s_slot_us;
+
+if( ( s_slot_used[slot / 8] & ( 1 << ( slot % 8 ) ) ) != 0 )
+    {
+    s_stats.collisions++;
+    return;
+    }
+
+s_slot_used[slot / 8] |= ( 1 << ( slot % 8 ) );
+s_stats.slots_occupied++;
+
+} /* tdma_record_slot() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_gateway_init
+*
+*   DESCRIPTION:
+*       computes slot and guard lengths at the current modem
+*       settings and takes the gateway role. Turnaround is never
+*       taken below the time from the end of a packet until the
+*       sender is back in rx: lora_transmit() returns no sooner
+*       than one mode delay after the start, then
+*       lora_init_continious_rx() takes
+*       lora_get_rx_turnaround_us(). Fails if the clock error
+*       leaves no room for slots.
+*
+*********************************************************************/
+bool lora_tdma_gateway_init
+    (
+    lora_tdma_config config               /* gateway schedule       */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t beacon_air_us;         /* beacon time on air     */
+uint32_t slot_air_us;           /* slot frame time on air */
+uint32_t frame_us;              /* frame without guards   */
+uint32_t guard_us;              /* guard time per slot    */
+uint32_t turnaround_us;         /* rx / tx switch time    */
+uint32_t short_air_us;          /* shorter packet airtime */
+uint64_t drift_ppm;             /* relative drift between
+                                   beacons                */
+uint64_t guards_ppm;            /* drift of the guards    */
+
+/*----------------------------------------------------------
+Verify schedule
+----------------------------------------------------------*/
+if( config.slot_count == 0 || config.max_payload == 0 )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+beacon_air_us = lora_get_time_on_air_us( TDMA_BEACON_SIZE );
+slot_air_us   = lora_get_time_on_air_us( config.max_payload );
+frame_us      = beacon_air_us + ( config.slot_count * slot_air_us );
+short_air_us  = ( beacon_air_us < slot_air_us ) ? beacon_air_us : slot_air_us;
+turnaround_us = lora_get_rx_turnaround_us();
+drift_ppm     = 2ULL * ( LORA_TDMA_MAX_MISSED_BEACONS + 1 ) * config.clock_ppm;
+guards_ppm    = drift_ppm * ( config.slot_count + 1 );
+
+/*----------------------------------------------------------
+A packet shorter than the mode delay holds its sender out
+of rx past the end of the packet
+----------------------------------------------------------*/
+if( lora_get_mode_delay_us() > short_air_us )
+    {
+    turnaround_us += lora_get_mode_delay_us() - short_air_us;
+    }
+
+if( config.turnaround_us > turnaround_us )
+    {
+    turnaround_us = config.turnaround_us;
+    }
+
+/*----------------------------------------------------------
+Guard covers turnaround and the drift of both clocks over
+every frame a node may send without a beacon. The frame
+includes the guards, so solve
+    guard = turnaround + drift * ( frame + ( slots + 1 ) * guard )
+----------------------------------------------------------*/
+if( guards_ppm >= PPM_SCALE )
+    {
+    return false;
+    }
+
+guard_us = (uint32_t)( ( ( (uint64_t)turnaround_us * PPM_SCALE ) + ( frame_us * drift_ppm ) +
+                         ( PPM_SCALE - guards_ppm ) - 1 ) / ( PPM_SCALE - guards_ppm ) );
+
+s_is_gateway     = true;
+s_synced         = false;
+s_slot_count     = config.slot_count;
+s_max_payload    = config.max_payload;
+s_first_slot_us  = beacon_air_us + guard_us;
+s_slot_us        = slot_air_us + guard_us;
+s_frame_number   = 0;
+
+return true;
+
+} /* lora_tdma_gateway_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_send_beacon
+*
+*   DESCRIPTION:
+*       sends beacon at the start of the next frame, or now if
+*       no frame has been sent yet, then returns to continious
+*       rx for the node slots. Blocks until the frame start,
+*       see lora_tdma_time_until_tx_us().
+*
+*********************************************************************/
+bool lora_tdma_send_beacon
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint8_t  beacon[TDMA_BEACON_SIZE]; /* beacon frame        */
+uint32_t start_us;                 /* frame start time    */
+uint32_t i;                        /* interator           */
+
+if( !s_is_gateway )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Build and load beacon ahead of the frame start
+----------------------------------------------------------*/
+beacon[0]  = TDMA_BEACON_TYPE;
+beacon[1]  = s_frame_number;
+beacon[2]  = s_slot_count;
+beacon[3]  = s_max_payload;
+beacon[4]  = (uint8_t)( s_first_slot_us );
+beacon[5]  = (uint8_t)( s_first_slot_us >> 8 );
+beacon[6]  = (uint8_t)( s_first_slot_us >> 16 );
+beacon[7]  = (uint8_t)( s_first_slot_us >> 24 );
+beacon[8]  = (uint8_t)( s_slot_us );
+beacon[9]  = (uint8_t)( s_slot_us >> 8 );
+beacon[10] = (uint8_t)( s_slot_us >> 16 );
+beacon[11] = (uint8_t)( s_slot_us >> 24 );
+
+if( !lora_load_message( beacon, TDMA_BEACON_SIZE ) )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Fire at frame start
+----------------------------------------------------------*/
+if( !s_synced || !tdma_next_start( lora_tdma_frame_length_us(), &start_us ) )
+    {
+    start_us = lora_get_time_us();
+    }
+
+tdma_wait_until( start_us );
+
+if( !lora_transmit() )
+    {
+    return false;
+    }
+
+s_frame_start_us = lora_get_tx_start_time();
+s_synced         = true;
+s_frame_number++;
+s_stats.beacons_sent++;
+s_stats.slots_offered += s_slot_count;
+
+for( i = 0; i < sizeof( s_slot_used ); i++ )
+    {
+    s_slot_used[i] = 0;
+    }
+
+return lora_init_continious_rx();
+
+} /* lora_tdma_send_beacon() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_node_init
+*
+*   DESCRIPTION:
+*       takes the node role in the given slot. Node can send
+*       once a beacon has been received.
+*
+*********************************************************************/
+void lora_tdma_node_init
+    (
+    uint8_t slot                          /* slot assigned to node  */
+    )
+{
+s_is_gateway = false;
+s_synced     = false;
+s_slot       = slot;
+
+} /* lora_tdma_node_init() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_send
+*
+*   DESCRIPTION:
+*       loads message, waits for the start of this node's next
+*       slot and sends, then returns to continious rx. Fails
+*       if not synced or the message does not fit the slot.
+*       Blocks until the slot, see lora_tdma_time_until_tx_us().
+*
+*********************************************************************/
+bool lora_tdma_send
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t start_us;              /* slot start time        */
+
+/*----------------------------------------------------------
+Verify node is synced and message fits slot
+----------------------------------------------------------*/
+if( s_is_gateway || !s_synced || s_slot >= s_slot_count ||
+    number_of_bytes > s_max_payload )
+    {
+    s_stats.slots_missed++;
+    return false;
+    }
+
+/*----------------------------------------------------------
+Load first so the fifo fill is not inside the slot
+----------------------------------------------------------*/
+if( !lora_load_message( Message, number_of_bytes ) )
+    {
+    return false;
+    }
+
+if( !tdma_next_start( s_first_slot_us + ( s_slot * s_slot_us ), &start_us ) )
+    {
+    s_synced = false;
+    s_stats.slots_missed++;
+    lora_init_continious_rx();
+    return false;
+    }
+
+/*----------------------------------------------------------
+Fire at slot start
+----------------------------------------------------------*/
+tdma_wait_until( start_us );
+
+if( !lora_transmit() )
+    {
+    return false;
+    }
+
+s_stats.slots_used++;
+
+return lora_init_continious_rx();
+
+} /* lora_tdma_send() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_get_message
+*
+*   DESCRIPTION:
+*       lora_get_message() for TDMA. Beacons are consumed to
+*       resync nodes and return false. message[] must hold at
+*       least a beacon or beacons are missed.
+*
+*********************************************************************/
+bool lora_tdma_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    )
+{
+if( !lora_get_message( message, size_of_message, size, error ) )
+    {
+    return false;
+    }
+
+/*----------------------------------------------------------
+Count corrupt packets, likely collisions
+----------------------------------------------------------*/
+if( *error == RX_CRC_ERROR || *error == RX_INVALID_HEADER )
+    {
+    s_stats.collisions++;
+    return true;
+    }
+
+/*----------------------------------------------------------
+Consume beacons
+----------------------------------------------------------*/
+if( *error == RX_NO_ERROR && *size == TDMA_BEACON_SIZE &&
+    message[0] == TDMA_BEACON_TYPE )
+    {
+    if( !s_is_gateway )
+        {
+        tdma_process_beacon( message );
+        }
+    *size = 0;
+    return false;
+    }
+
+if( *error == RX_NO_ERROR && s_is_gateway )
+    {
+    tdma_record_slot( *size );
+    }
+
+return true;
+
+} /* lora_tdma_get_message() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_time_until_tx_us
+*
+*   DESCRIPTION:
+*       returns time until lora_tdma_send_beacon() (gateway) or
+*       lora_tdma_send() (node) should be called, allowing for
+*       the fifo load ahead of the start. 0 means call now,
+*       LORA_TDMA_NOT_SYNCED that a node has no slot to send in.
+*
+*********************************************************************/
+uint32_t lora_tdma_time_until_tx_us
+    (
+    void
+    )
+{
+/*----------------------------------------------------------
+Local variables
+----------------------------------------------------------*/
+uint32_t offset_us;             /* start offset in frame  */
+uint32_t start_us;              /* next start time        */
+uint32_t lead_us;               /* load time before start */
+uint32_t now_us;                /* current time           */
+
+/*----------------------------------------------------------
+Initilize local variables
+----------------------------------------------------------*/
+offset_us = s_is_gateway ? lora_tdma_frame_length_us() :
+                           s_first_slot_us + ( s_slot * s_slot_us );
+lead_us   = lora_get_mode_delay_us() + TDMA_LOAD_MARGIN_US;
+
+/*----------------------------------------------------------
+Gateway without a frame sends now, node without a beacon
+cannot send
+----------------------------------------------------------*/
+if( !s_synced || !tdma_next_start( offset_us, &start_us ) )
+    {
+    return s_is_gateway ? 0 : LORA_TDMA_NOT_SYNCED;
+    }
+
+if( !s_is_gateway && s_slot >= s_slot_count )
+    {
+    return LORA_TDMA_NOT_SYNCED;
+    }
+
+now_us = lora_get_time_us();
+
+if( start_us - now_us <= lead_us )
+    {
+    return 0;
+    }
+
+return start_us - now_us - lead_us;
+
+} /* lora_tdma_time_until_tx_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_frame_length_us
+*
+*   DESCRIPTION:
+*       returns beacon slot plus all node slots
+*
+*********************************************************************/
+uint32_t lora_tdma_frame_length_us
+    (
+    void
+    )
+{
+return s_first_slot_us + ( s_slot_count * s_slot_us );
+
+} /* lora_tdma_frame_length_us() */
+
+/*********************************************************************
+*
+*   PROCEDURE NAME:
+*       lora_tdma_get_stats
+*
+*   DESCRIPTION:
+*       returns TDMA counters
+*
+*********************************************************************/
+void lora_tdma_get_stats
+    (
+    lora_tdma_stats *stats                /* returned counters      */
+    )
+{
+*stats = s_stats;
+
+} /* lora_tdma_get_stats() */
@@ -0,0 +1,124 @@
+/*********************************************************************
+*
+*   HEADER:
+*       header file for loraTDMA
+*
+*   Copyright 2020 Nate Lenze
+*
+*********************************************************************/
+
+#ifndef LORA_TDMA_H
+#define LORA_TDMA_H
+
+/*--------------------------------------------------------------------
+                           GENERAL INCLUDES
+--------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LoraAPI.h"
+
+/*--------------------------------------------------------------------
+                          LITERAL CONSTANTS
+--------------------------------------------------------------------*/
+#define LORA_TDMA_MAX_MISSED_BEACONS ( 4 ) /* frames a node keeps its
+                                              slot without a beacon     */
+
+#define LORA_TDMA_NOT_SYNCED    ( 0xFFFFFFFFUL )
+                                           /* node has no slot to send  */
+
+/*--------------------------------------------------------------------
+                                TYPES
+--------------------------------------------------------------------*/
+typedef struct
+    {
+    uint8_t  slot_count;                  /* node slots per frame   */
+    uint8_t  max_payload;                 /* largest frame per slot */
+    uint16_t clock_ppm;                   /* worst case clock error */
+    uint32_t turnaround_us;               /* rx / tx switch time,
+                                             raised to the driver
+                                             minimum if below       */
+    } lora_tdma_config;                   /* gateway schedule       */
+
+typedef struct
+    {
+    uint32_t beacons_sent;                /* gateway beacons        */
+    uint32_t beacons_received;            /* node beacons heard     */
+    uint32_t slots_used;                  /* frames sent in slot    */
+    uint32_t slots_missed;                /* sends with no sync     */
+    uint32_t slots_offered;               /* gateway node slots,
+                                             utilisation is
+                                             occupied / offered     */
+    uint32_t slots_occupied;              /* gateway slots a packet
+                                             was received in        */
+    uint32_t collisions;                  /* corrupt packets, and at
+                                             the gateway packets
+                                             outside a slot or in a
+                                             used slot              */
+    } lora_tdma_stats;                    /* TDMA counters          */
+
+/*--------------------------------------------------------------------
+                           MEMORY CONSTANTS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              VARIABLES
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                                MACROS
+--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------
+                              PROCEDURES
+--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+loraTDMA.c
+--------------------------------------------------------------------*/
+bool lora_tdma_gateway_init
+    (
+    lora_tdma_config config               /* gateway schedule       */
+    );
+
+bool lora_tdma_send_beacon
+    (
+    void
+    );
+
+void lora_tdma_node_init
+    (
+    uint8_t slot                          /* slot assigned to node  */
+    );
+
+bool lora_tdma_send
+    (
+    uint8_t Message[],                    /* array of bytes to send */
+    uint8_t number_of_bytes               /* size of array          */
+    );
+
+bool lora_tdma_get_message
+    (
+    uint8_t *message,                  /* pointer to return message */
+    uint8_t size_of_message,           /* array size of message[]   */
+    uint8_t *size,                     /* size of return message    */
+    lora_errors *error                 /* pointer to error variable */
+    );
+
+uint32_t lora_tdma_time_until_tx_us
+    (
+    void
+    );
+
+uint32_t lora_tdma_frame_length_us
+    (
+    void
+    );
+
+void lora_tdma_get_stats
+    (
+    lora_tdma_stats *stats                /* returned counters      */
+    );
+
+#endif /* LORA_TDMA_H */
+
+/* LoraTDMA.h */